@@ -0,0 +1,156 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   aging_calibrator.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief estimator of the DS3231 aging offset from GPS time
+ *
+ * Pairs (GPS time, RTC - GPS offset) are collected over a long window, the drift
+ * is the slope of the least-squares line through them. One LSB of the aging
+ * register is about 0.1 ppm, positive values slow the oscillator down.
+ * The correction is applied in bounded steps, the window starts again after each
+ * step because the frequency has changed. Pure computation, no bus access.
+ */
+class AgingCalibrator
+{
+public:
+    static constexpr float _ppmPerLsb = 0.1f;
+
+public:
+    /**
+     * @brief Construct a new calibrator
+     *
+     * @param aging current (persisted) aging offset
+     * @param maxStep largest change of the register per update
+     * @param minWindowS shortest window for an estimate
+     * @param minSamples fewest samples for an estimate
+     */
+    explicit AgingCalibrator(int8_t aging = 0,
+                             uint8_t maxStep = 10,
+                             uint32_t minWindowS = 6 * 3600,
+                             uint16_t minSamples = 16) : _aging(aging),
+                                                         _maxStep(maxStep),
+                                                         _minWindowS(minWindowS),
+                                                         _minSamples(minSamples)
+    {
+    }
+
+    /**
+     * @brief drops the collected samples, e.g. after the RTC was set
+     *
+     */
+    void reset()
+    {
+        _n = 0;
+        _sumT = _sumY = _sumTT = _sumTY = 0;
+    }
+
+    /**
+     * @brief adds the comparison with a validated GPS fix
+     *
+     * @param gpsSeconds GPS time of the fix (e.g. unixtime)
+     * @param offsetUs RTC time - GPS time in microseconds
+     */
+    void addSample(uint32_t gpsSeconds, int64_t offsetUs)
+    {
+        if (_n == 0)
+        {
+            _t0 = gpsSeconds;
+            _y0 = offsetUs;
+        }
+
+        // relative to the first sample, keeps the sums small
+        double t = (double)(gpsSeconds - _t0);
+        double y = (double)(offsetUs - _y0);
+        _n++;
+        _sumT += t;
+        _sumY += y;
+        _sumTT += t * t;
+        _sumTY += t * y;
+        _last = gpsSeconds;
+    }
+
+    /**
+     * @brief is the window long enough for an estimate
+     *
+     */
+    bool ready() const
+    {
+        return _n >= _minSamples && (_last - _t0) >= _minWindowS;
+    }
+
+    /**
+     * @brief drift of the RTC, slope of the offset
+     *
+     * @return float - ppm, positive - RTC runs fast
+     */
+    float driftPpm() const
+    {
+        double den = _n * _sumTT - _sumT * _sumT;
+        if (_n < 2 || den <= 0)
+            return 0;
+
+        // microseconds per second = ppm
+        return (float)((_n * _sumTY - _sumT * _sumY) / den);
+    }
+
+    /**
+     * @brief computes the new aging offset when the window is complete
+     *
+     * @param aging [out] value to program into the register (and to persist)
+     * @return true - the register has to be updated
+     * @return false - no estimate yet or no change
+     */
+    bool update(int8_t &aging)
+    {
+        if (!ready())
+            return false;
+
+        // truncated - a deadband of one LSB, no hunting around the optimum
+        int32_t step = (int32_t)(driftPpm() / _ppmPerLsb);
+        if (step > _maxStep)
+            step = _maxStep;
+        if (step < -(int32_t)_maxStep)
+            step = -(int32_t)_maxStep;
+
+        int32_t next = _aging + step;
+        if (next > 127)
+            next = 127;
+        if (next < -128)
+            next = -128;
+
+        reset();
+        if (next == _aging)
+            return false;
+
+        _aging = next;
+        aging = _aging;
+        return true;
+    }
+
+    int8_t aging() const { return _aging; }
+    void setAging(int8_t aging) { _aging = aging; }
+    uint16_t samples() const { return _n; }
+
+private:
+    int8_t _aging{0};
+    uint8_t _maxStep{10};
+    uint32_t _minWindowS{0};
+    uint16_t _minSamples{0};
+
+    uint16_t _n{0};
+    uint32_t _t0{0};
+    uint32_t _last{0};
+    int64_t _y0{0};
+    double _sumT{0};
+    double _sumY{0};
+    double _sumTT{0};
+    double _sumTY{0};
+};
@@ -41,22 +41,98 @@ bool AT2432::init(bool initI2c)
 
 void AT2432::writeIO(uint16_t addr, const uint8_t data)
 {
-    uint8_t dta[3];
+    writeBlock(addr, &data, 1);
+}
+
+bool AT2432::writeBlock(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+    if (_delta)
+        return updateBlock(addr, data, len);
+
+    auto rc = AT24Block::write(*this, addr, data, len);
+    if (rc)
+        _chksum = Crc::crc16(data, len, _chksum);
+    return rc;
+}
+
+bool AT2432::updateBlock(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+    auto rc = AT24Block::update(*this, addr, data, len, _deltaStats);
+    if (rc)
+        _chksum = Crc::crc16(data, len, _chksum);
+    return rc;
+}
+
+bool AT2432::pageWrite(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+    if (len > _pageSize)
+        return false;
+
+    uint8_t dta[2 + _pageSize];
     dta[0] = addr >> 8;     // MSB
     dta[1] = addr & 0xff ;  // LSB
-    dta[2] = data;
-    i2c_write_blocking(_i2c, _address, dta, 3, false);
-    _chksum ^= data;
+    memcpy(dta + 2, data, len);
+    return i2c_write_blocking(_i2c, _address, dta, 2 + len, false) == (int)(2 + len);
+}
+
+bool AT2432::isReady()
+{
+    // rp2040 cannot send an address-only write, a one byte read is used for polling
+    uint8_t data;
+    return !(i2c_read_blocking(_i2c, _address, &data, 1, false) < 0);
+}
+
+bool AT2432::waitReady()
+{
+    auto start = time_us_64();
+    while (!isReady())
+    {
+        if (time_us_64() - start > _readyTimeoutUs)
+            return false;
+    }
+    return true;
 }
 
 uint8_t AT2432::readIO(uint16_t addr)
 {
     uint8_t data = 0;
+    readBlock(addr, &data, 1);
+    return data;
+}
+
+bool AT2432::readBlock(uint16_t addr, uint8_t *data, uint16_t len)
+{
+    if (!seqRead(addr, data, len))
+        return false;
+
+    _chksum = Crc::crc16(data, len, _chksum);
+    return true;
+}
+
+bool AT2432::verifyRange(uint16_t addr, uint16_t len, uint16_t expected)
+{
+    uint8_t chunk[2 * _pageSize];
+    uint16_t crc = Crc::_crc16Init;
+    while (len)
+    {
+        uint16_t n = (len < sizeof(chunk)) ? len : sizeof(chunk);
+        if (!seqRead(addr, chunk, n))
+            return false;
+
+        crc = Crc::crc16(chunk, n, crc);
+        addr = (addr + n) & (_memSize - 1);
+        len -= n;
+    }
+    return crc == expected;
+}
+
+bool AT2432::seqRead(uint16_t addr, uint8_t *data, uint16_t len)
+{
     uint8_t dta[2];
     dta[0] = addr >> 8; // MSB
     dta[1] = addr & 0xff ; // LSB
-    i2c_write_blocking(_i2c, _address, dta, 2, true);
-    i2c_read_blocking(_i2c, _address, &data, 1, false);
-    _chksum ^= data;
-    return data;
+    if (i2c_write_blocking(_i2c, _address, dta, 2, true) != 2)
+        return false;
+
+    return i2c_read_blocking(_i2c, _address, data, len, false) == (int)len;
 }
@@ -10,6 +10,8 @@
 #include <inttypes.h>
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
+#include "crc.h"
+#include "at24_block.h"
 
 /**
  * @brief  Serial EEPROM, 32K (4096 x 8) basic operation
@@ -18,6 +20,11 @@
 class AT2432
 {
 
+public:
+    static constexpr uint16_t _pageSize = 32;
+    static constexpr uint16_t _memSize = 4096;
+    static constexpr uint32_t _readyTimeoutUs = 20000; // tWR is 5 ms max
+
 public:
 
     /**
@@ -43,12 +50,89 @@ public:
     bool init(bool initI2c);
 
     /**
-     * @brief  writes the octet from memory space
+     * @brief  writes the octet from memory space and waits for the write cycle
      * 
      * @param addr memory location address
      * @param data  - octet value
      */
     void writeIO(uint16_t addr, const uint8_t data);
+
+    /**
+     * @brief writes the buffer - split on page boundaries, one transaction per page,
+     *        each write cycle finished by ACK polling
+     * 
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length of the buffer
+     * @return true - success
+     * @return false - the chip did not acknowledge
+     */
+    bool writeBlock(uint16_t addr, const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief compare-before-write - reads each target page in one burst and writes only
+     *        the pages that differ, unchanged pages cost no write cycle
+     * 
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length of the buffer
+     * @return true - success
+     * @return false - the chip did not acknowledge
+     */
+    bool updateBlock(uint16_t addr, const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief delta mode - writeBlock() and writeIO() compare before write
+     * 
+     * @param on true - enabled
+     */
+    void setDeltaMode(bool on) {
+        _delta = on;
+    }
+
+    /**
+     * @brief statistics of the compare-before-write
+     * 
+     * @return const AT24Block::DeltaStats& 
+     */
+    const AT24Block::DeltaStats &deltaStats() const {
+        return _deltaStats;
+    }
+
+    /**
+     * @brief clears the statistics of the compare-before-write
+     * 
+     */
+    void clearDeltaStats() {
+        memset(&_deltaStats, 0, sizeof(_deltaStats));
+    }
+
+    /**
+     * @brief single page write transaction, does not wait for the write cycle
+     * 
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length, the data must not cross the page boundary
+     * @return true - acknowledged
+     * @return false - busy or invalid length
+     */
+    bool pageWrite(uint16_t addr, const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief ACK polling - the chip does not acknowledge its address during the write cycle
+     * 
+     * @return true - ready
+     * @return false - write cycle in progress
+     */
+    bool isReady();
+
+    /**
+     * @brief polls the chip until the write cycle is finished
+     * 
+     * @return true - ready
+     * @return false - timeout
+     */
+    bool waitReady();
     
     /**
      * @brief reads the octet to memory
@@ -58,20 +142,54 @@ public:
      */
     uint8_t readIO(uint16_t addr);
 
+    /**
+     * @brief sequential read - one address write followed by a single read of any length,
+     *        the address counter of the chip rolls over at the end of the memory
+     * 
+     * @param addr memory location address
+     * @param data [out] buffer
+     * @param len length of the buffer
+     * @return true - success
+     * @return false - the chip did not acknowledge
+     */
+    bool readBlock(uint16_t addr, uint8_t *data, uint16_t len);
+
+    /**
+     * @brief reads the range and compares its CRC-16/CCITT, the running checksum is not touched
+     * 
+     * @param addr memory location address
+     * @param len length of the range
+     * @param expected expected CRC-16/CCITT of the range
+     * @return true - the range matches
+     * @return false - mismatch or read failed
+     */
+    bool verifyRange(uint16_t addr, uint16_t len, uint16_t expected);
+
+    /**
+     * @brief sequential read without the checksum update
+     * 
+     * @param addr memory location address
+     * @param data [out] buffer
+     * @param len length of the buffer
+     * @return true - success
+     * @return false - the chip did not acknowledge
+     */
+    bool seqRead(uint16_t addr, uint8_t *data, uint16_t len);
+
     /**
      * @brief clears the checksum 
      * 
      */
     void clearCheckSum() {
-        _chksum = 0;
+        _chksum = Crc::_crc16Init;
     }
 
     /**
-     * @brief Get the checksum value from read/write operations
+     * @brief Get the checksum value from read/write operations - CRC-16/CCITT
      * 
-     * @return uint8_t 
+     * @return uint16_t 
      */
-    uint8_t checkSum() {
+    uint16_t checkSum() {
         return _chksum;
     }
 
@@ -81,6 +199,8 @@ private:
     uint8_t _sda{0};
     uint8_t _scl{0};
     uint8_t _address{0};
-    uint8_t _chksum {0};
+    uint16_t _chksum {Crc::_crc16Init};
+    bool _delta {false};
+    AT24Block::DeltaStats _deltaStats {};
 
 };
@@ -0,0 +1,138 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   at24_block.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * @brief block algorithms shared by the AT24Cxx serial EEPROM driver and its host model
+ *
+ * The device type has to provide:
+ *  - static constexpr uint16_t _pageSize, _memSize
+ *  - bool pageWrite(uint16_t addr, const uint8_t *data, uint16_t len) - one transaction, no wait
+ *  - bool waitReady() - ACK polling until the internal write cycle is finished
+ *  - bool seqRead(uint16_t addr, uint8_t *data, uint16_t len) - sequential read
+ */
+class AT24Block
+{
+public:
+    /**
+     * @brief result of the compare-before-write
+     *
+     */
+    struct DeltaStats
+    {
+        uint32_t _pagesWritten; // pages with a change
+        uint32_t _pagesSkipped; // unchanged pages, no write cycle
+        uint32_t _bytesWritten; // bytes sent in page writes
+        uint32_t _bytesSkipped; // bytes not sent
+    };
+
+public:
+    /**
+     * @brief number of bytes that can be written from the address without crossing a page boundary
+     *
+     * @param pageSize page size of the device
+     * @param addr memory location address
+     * @param len requested length
+     * @return uint16_t - length of the first chunk
+     */
+    static constexpr uint16_t pageChunk(uint16_t pageSize, uint16_t addr, uint16_t len)
+    {
+        uint16_t room = pageSize - (addr % pageSize);
+        return (len < room) ? len : room;
+    }
+
+    /**
+     * @brief writes the buffer split on page boundaries, one transaction per page,
+     *        and waits for every write cycle by ACK polling
+     *
+     * @param dev device instance
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length of the buffer
+     * @return true - all pages written
+     * @return false - device did not acknowledge
+     */
+    template <class Dev>
+    static bool write(Dev &dev, uint16_t addr, const uint8_t *data, uint16_t len)
+    {
+        while (len)
+        {
+            auto chunk = pageChunk(Dev::_pageSize, addr, len);
+            if (!dev.pageWrite(addr, data, chunk) || !dev.waitReady())
+            {
+                return false;
+            }
+
+            // the address counter of the chip rolls over at the end of the memory
+            addr = (addr + chunk) & (Dev::_memSize - 1);
+            data += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief compare-before-write - reads every target page in one burst and writes
+     *        only the changed span of the pages that differ, unchanged pages are skipped
+     *
+     * @param dev device instance
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length of the buffer
+     * @param stats [in,out] accumulated statistics
+     * @return true - content matches the buffer
+     * @return false - device did not acknowledge
+     */
+    template <class Dev>
+    static bool update(Dev &dev, uint16_t addr, const uint8_t *data, uint16_t len, DeltaStats &stats)
+    {
+        uint8_t page[Dev::_pageSize];
+        while (len)
+        {
+            auto chunk = pageChunk(Dev::_pageSize, addr, len);
+            if (!dev.seqRead(addr, page, chunk))
+            {
+                return false;
+            }
+
+            uint16_t first = 0;
+            while (first < chunk && page[first] == data[first])
+                first++;
+
+            if (first == chunk)
+            {
+                stats._pagesSkipped++;
+                stats._bytesSkipped += chunk;
+            }
+            else
+            {
+                uint16_t last = chunk - 1;
+                while (page[last] == data[last])
+                    last--;
+
+                uint16_t span = last - first + 1;
+                if (!dev.pageWrite(addr + first, data + first, span) || !dev.waitReady())
+                {
+                    return false;
+                }
+
+                stats._pagesWritten++;
+                stats._bytesWritten += span;
+                stats._bytesSkipped += chunk - span;
+            }
+
+            addr = (addr + chunk) & (Dev::_memSize - 1);
+            data += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+};
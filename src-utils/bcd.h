@@ -0,0 +1,109 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   bcd.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * @brief binary -> BCD table, generated at compile time
+ *
+ */
+struct BcdTable
+{
+    uint8_t _bcd[100];
+
+    static constexpr BcdTable make()
+    {
+        BcdTable t{};
+        for (uint8_t i = 0; i < 100; i++)
+            t._bcd[i] = (uint8_t)(((i / 10) << 4) | (i % 10));
+        return t;
+    }
+};
+
+/**
+ * @brief packed BCD codec without division (the M0+ has no divider instruction)
+ *
+ *  - decode: tens * 10 + units == val - 6 * tens, done for 8 bytes at once in a 64 bit word (SWAR)
+ *  - encode: 100 entry table
+ *
+ * Inputs are expected to be valid (BCD digits 0 - 9, numbers 0 - 99).
+ */
+class Bcd
+{
+public:
+    static constexpr BcdTable _table = BcdTable::make();
+
+    /**
+     * @brief BCD -> number
+     *
+     * @param val BCD 0x00 - 0x99
+     * @return uint8_t
+     */
+    static constexpr uint8_t decode(uint8_t val)
+    {
+        return (uint8_t)(val - 6 * (val >> 4));
+    }
+
+    /**
+     * @brief number -> BCD
+     *
+     * @param val 0 - 99, larger values give 0
+     * @return uint8_t
+     */
+    static constexpr uint8_t encode(uint8_t val)
+    {
+        return (val < 100) ? _table._bcd[val] : 0;
+    }
+
+    /**
+     * @brief decodes up to 8 bytes in one word
+     *
+     * Each lane is below 0x9A, so val - 6 * tens never borrows across lanes.
+     *
+     * @param x packed BCD bytes
+     * @return uint64_t numbers in the same lanes
+     */
+    static constexpr uint64_t decode8(uint64_t x)
+    {
+        uint64_t tens = (x >> 4) & 0x0f0f0f0f0f0f0f0full;
+        return x - ((tens << 2) + (tens << 1)); // * 6, no 64 bit multiply call
+    }
+
+    /**
+     * @brief decodes a register block, the control bits are masked out first
+     *
+     * @param in BCD registers
+     * @param out [out] numbers, may be the same buffer as in
+     * @param len 1 - 8
+     * @param mask valid bits of each byte, nullptr - all
+     */
+    static void decodeBlock(const uint8_t *in, uint8_t *out, uint8_t len, const uint8_t *mask = nullptr)
+    {
+        uint64_t x = 0, m = ~0ull;
+        memcpy(&x, in, len);
+        if (mask)
+            memcpy(&m, mask, len);
+        x = decode8(x & m);
+        memcpy(out, &x, len);
+    }
+
+    /**
+     * @brief encodes a block of numbers
+     *
+     * @param in numbers 0 - 99
+     * @param out [out] BCD, may be the same buffer as in
+     * @param len length
+     */
+    static void encodeBlock(const uint8_t *in, uint8_t *out, uint8_t len)
+    {
+        for (uint8_t i = 0; i < len; i++)
+            out[i] = encode(in[i]);
+    }
+};
@@ -0,0 +1,213 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   clock_manager.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include "wall_clock.h"
+
+/**
+ * @brief selection of the best time source - GPS, DS3231, internal RTC
+ *
+ * Every source reports a reading (epoch time at a local timer stamp) with its
+ * own error estimate. Between readings the time is carried on by the local timer
+ * and the error grows by the holdover rate with the age of the reading. Readings
+ * older than maxAgeUs are not valid. A source is replaced only when another one
+ * is better by more than the hysteresis, or when it has expired.
+ *
+ * The chosen time is published through a monotonic WallClock, now() is cheap.
+ * Pure computation, no platform dependencies.
+ */
+class ClockManager
+{
+public:
+    enum class Source : uint8_t
+    {
+        Gps = 0,
+        Rtc,      // DS3231
+        Internal, // TimeBase
+        None
+    };
+
+    static constexpr uint8_t _sources = 3;
+    static constexpr int64_t _noError = INT64_MAX;
+
+public:
+    /**
+     * @brief Construct a new manager
+     *
+     * @param holdoverPpm growth of the error of a reading, drift of the local timer
+     * @param hysteresisUs advantage needed to switch to another source
+     * @param maxAgeUs readings older than this are not valid
+     */
+    explicit ClockManager(uint32_t holdoverPpm = 50,
+                          uint32_t hysteresisUs = 1000,
+                          uint64_t maxAgeUs = 3600ull * 1000000) : _holdoverPpm(holdoverPpm),
+                                                                   _hysteresisUs(hysteresisUs),
+                                                                   _maxAgeUs(maxAgeUs)
+    {
+    }
+
+    /**
+     * @brief new reading of a source
+     *
+     * @param src source
+     * @param epochUs time of the source at localUs
+     * @param localUs local timer stamp of the reading
+     * @param errorUs estimated error of the reading
+     * @param nowUs local timer now, not before localUs
+     */
+    void report(Source src, int64_t epochUs, uint64_t localUs, uint32_t errorUs, uint64_t nowUs)
+    {
+        auto &r = _readings[(uint8_t)src];
+        r._epochUs = epochUs;
+        r._localUs = localUs;
+        r._errorUs = errorUs;
+        r._valid = true;
+
+        if (!select(nowUs) && src == _source)
+            publish(nowUs);
+    }
+
+    /**
+     * @brief the source is known to be wrong, e.g. GPS fix lost or RTC oscillator stopped
+     *
+     * @param src source
+     * @param localUs local timer now
+     */
+    void invalidate(Source src, uint64_t localUs)
+    {
+        _readings[(uint8_t)src]._valid = false;
+        select(localUs);
+    }
+
+    /**
+     * @brief re-ranks the sources, readings expire with time
+     *
+     * @param localUs local timer now
+     * @return true - the source has changed
+     */
+    bool update(uint64_t localUs)
+    {
+        return select(localUs);
+    }
+
+    /**
+     * @brief error of a source now
+     *
+     * @param src source
+     * @param localUs local timer now
+     * @return int64_t - microseconds, _noError for no valid reading
+     */
+    int64_t errorUs(Source src, uint64_t localUs) const
+    {
+        if (src == Source::None)
+            return _noError;
+
+        // a reading stamped after localUs has no age yet
+        auto &r = _readings[(uint8_t)src];
+        uint64_t age = (localUs > r._localUs) ? localUs - r._localUs : 0;
+        if (!r._valid || age > _maxAgeUs)
+            return _noError;
+        return (int64_t)r._errorUs + (int64_t)(age * _holdoverPpm / 1000000);
+    }
+
+    /**
+     * @brief error of the published time
+     *
+     * @param localUs local timer now
+     * @return int64_t - microseconds, _noError for no source
+     */
+    int64_t errorUs(uint64_t localUs) const
+    {
+        return errorUs(_source, localUs);
+    }
+
+    /**
+     * @brief published time, one timer read and an add
+     *
+     * @param localUs local timer now, e.g. time_us_64()
+     * @return int64_t - epoch microseconds, 0 before the first source
+     */
+    int64_t now(uint64_t localUs) const
+    {
+        return _clock.now(localUs);
+    }
+
+    Source source() const { return _source; }
+    uint32_t switches() const { return _switches; }
+
+private:
+    struct Reading
+    {
+        int64_t _epochUs;
+        uint64_t _localUs;
+        uint32_t _errorUs;
+        bool _valid;
+    };
+
+    /**
+     * @brief picks the best source with hysteresis
+     *
+     */
+    bool select(uint64_t localUs)
+    {
+        auto best = Source::None;
+        auto bestErr = _noError;
+        for (uint8_t i = 0; i < _sources; i++)
+        {
+            auto err = errorUs((Source)i, localUs);
+            if (err < bestErr)
+            {
+                best = (Source)i;
+                bestErr = err;
+            }
+        }
+
+        if (best == Source::None)
+        {
+            // all expired, the published clock runs on
+            if (_source == Source::None)
+                return false;
+            _source = Source::None;
+            _switches++;
+            return true;
+        }
+
+        auto curErr = errorUs(_source, localUs);
+        if (best == _source)
+            return false;
+
+        if (curErr != _noError && bestErr + (int64_t)_hysteresisUs >= curErr)
+            return false;
+
+        _source = best;
+        _switches++;
+        publish(localUs);
+        return true;
+    }
+
+    /**
+     * @brief carries the reading of the chosen source on, the time handed out until now is kept
+     *
+     */
+    void publish(uint64_t nowUs)
+    {
+        auto &r = _readings[(uint8_t)_source];
+        _clock.anchor(r._epochUs, r._localUs, nowUs);
+    }
+
+private:
+    uint32_t _holdoverPpm;
+    uint32_t _hysteresisUs;
+    uint64_t _maxAgeUs;
+
+    Reading _readings[_sources]{};
+    Source _source{Source::None};
+    uint32_t _switches{0};
+    WallClock _clock;
+};
@@ -0,0 +1,95 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   clock_slew.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include "wall_clock.h"
+
+/**
+ * @brief adjtime-like correction policy for a WallClock
+ *
+ * Offsets up to the step threshold are slewed - the clock runs at most maxPpm
+ * faster or slower until the offset is absorbed, intervals stay correct within
+ * that bound. Larger offsets, and the first one, step the clock (forward at once,
+ * backward by holding, see WallClock). Pure computation, no platform dependencies.
+ */
+class ClockSlew
+{
+public:
+    static constexpr uint32_t _defaultStepUs = 128000;
+    static constexpr uint32_t _defaultMaxPpm = 500;
+
+public:
+    /**
+     * @brief Construct a new policy
+     *
+     * @param stepUs smallest offset that steps the clock
+     * @param maxPpm slew rate
+     */
+    explicit ClockSlew(uint32_t stepUs = _defaultStepUs,
+                       uint32_t maxPpm = _defaultMaxPpm) : _stepUs(stepUs),
+                                                           _maxPpm(maxPpm)
+    {
+    }
+
+    /**
+     * @brief corrects the clock to the reference time
+     *
+     * The correction starts at nowUs, so the time already handed out
+     * after the reference stamp is never turned back.
+     *
+     * @param clock clock to correct
+     * @param referenceUs true epoch microseconds at localUs
+     * @param localUs local timer stamp of the reference
+     * @param nowUs local timer now, not before localUs
+     * @return true - stepped
+     * @return false - slewed
+     */
+    bool apply(WallClock &clock, int64_t referenceUs, uint64_t localUs, uint64_t nowUs)
+    {
+        int64_t reference = referenceUs + (int64_t)(nowUs - localUs);
+        if (!clock.valid())
+        {
+            clock.anchor(reference, nowUs);
+            _offsetUs = 0;
+            _steps++;
+            return true;
+        }
+
+        _offsetUs = reference - clock.now(nowUs);
+        if (_offsetUs >= (int64_t)_stepUs || _offsetUs <= -(int64_t)_stepUs)
+        {
+            clock.anchor(reference, nowUs);
+            _steps++;
+            return true;
+        }
+
+        clock.slew(_offsetUs, nowUs, _maxPpm);
+        _slews++;
+        return false;
+    }
+
+    /**
+     * @brief offset measured by the last apply()
+     *
+     * @return int64_t - reference - clock in microseconds
+     */
+    int64_t offsetUs() const { return _offsetUs; }
+
+    uint32_t stepUs() const { return _stepUs; }
+    uint32_t maxPpm() const { return _maxPpm; }
+    uint32_t steps() const { return _steps; }
+    uint32_t slews() const { return _slews; }
+
+private:
+    uint32_t _stepUs;
+    uint32_t _maxPpm;
+    int64_t _offsetUs{0};
+    uint32_t _steps{0};
+    uint32_t _slews{0};
+};
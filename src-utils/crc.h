@@ -0,0 +1,166 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   crc.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * @brief lookup tables, generated at compile time
+ *
+ */
+struct CrcTables
+{
+    uint16_t _crc16[256];
+    uint32_t _crc32[4][256]; // [0] - byte table, [1..3] - slice-by-4
+
+    static constexpr CrcTables make()
+    {
+        CrcTables t{};
+        for (uint16_t i = 0; i < 256; i++)
+        {
+            uint16_t c16 = i << 8;
+            uint32_t c32 = i;
+            for (uint8_t b = 0; b < 8; b++)
+            {
+                c16 = (c16 & 0x8000) ? (c16 << 1) ^ 0x1021 : (c16 << 1);
+                c32 = (c32 & 1) ? (c32 >> 1) ^ 0xedb88320 : (c32 >> 1);
+            }
+            t._crc16[i] = c16;
+            t._crc32[0][i] = c32;
+        }
+
+        for (uint16_t i = 0; i < 256; i++)
+        {
+            for (uint8_t k = 1; k < 4; k++)
+            {
+                auto prev = t._crc32[k - 1][i];
+                t._crc32[k][i] = (prev >> 8) ^ t._crc32[0][prev & 0xff];
+            }
+        }
+        return t;
+    }
+};
+
+/**
+ * @brief CRC engine
+ *  - CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff, no reflection, no final xor)
+ *  - CRC-32 (IEEE 802.3, as zlib)
+ *
+ * Every variant can be updated incrementally - the previous result is passed as crc.
+ * crc16() / crc32() select the table variants, or the bitwise ones when the build
+ * defines CRC_BITWISE (no tables in flash).
+ */
+class Crc
+{
+public:
+    static constexpr uint16_t _crc16Init = 0xffff;
+    static constexpr uint32_t _crc32Init = 0;
+    static constexpr CrcTables _tables = CrcTables::make();
+
+    /**
+     * @brief CRC-16/CCITT, the default variant of the build
+     *
+     * @param data buffer
+     * @param len length
+     * @param crc previous result for incremental update
+     * @return uint16_t
+     */
+    static uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = _crc16Init)
+    {
+#ifdef CRC_BITWISE
+        return crc16Bitwise(data, len, crc);
+#else
+        return crc16Table(data, len, crc);
+#endif
+    }
+
+    /**
+     * @brief CRC-32, the default variant of the build
+     *
+     * @param data buffer
+     * @param len length
+     * @param crc previous result for incremental update
+     * @return uint32_t
+     */
+    static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = _crc32Init)
+    {
+#ifdef CRC_BITWISE
+        return crc32Bitwise(data, len, crc);
+#else
+        return crc32Slice4(data, len, crc);
+#endif
+    }
+
+    static uint16_t crc16Bitwise(const uint8_t *data, size_t len, uint16_t crc = _crc16Init)
+    {
+        while (len--)
+        {
+            crc ^= (uint16_t)(*data++) << 8;
+            for (uint8_t b = 0; b < 8; b++)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+        return crc;
+    }
+
+    static uint16_t crc16Table(const uint8_t *data, size_t len, uint16_t crc = _crc16Init)
+    {
+        while (len--)
+        {
+            crc = (crc << 8) ^ _tables._crc16[(crc >> 8) ^ *data++];
+        }
+        return crc;
+    }
+
+    static uint32_t crc32Bitwise(const uint8_t *data, size_t len, uint32_t crc = _crc32Init)
+    {
+        crc = ~crc;
+        while (len--)
+        {
+            crc ^= *data++;
+            for (uint8_t b = 0; b < 8; b++)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+        }
+        return ~crc;
+    }
+
+    static uint32_t crc32Table(const uint8_t *data, size_t len, uint32_t crc = _crc32Init)
+    {
+        crc = ~crc;
+        while (len--)
+        {
+            crc = (crc >> 8) ^ _tables._crc32[0][(crc ^ *data++) & 0xff];
+        }
+        return ~crc;
+    }
+
+    /**
+     * @brief CRC-32 four bytes per step, costs 3 kB of additional tables
+     *
+     */
+    static uint32_t crc32Slice4(const uint8_t *data, size_t len, uint32_t crc = _crc32Init)
+    {
+        crc = ~crc;
+        while (len >= 4)
+        {
+            crc ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+            crc = _tables._crc32[3][crc & 0xff] ^
+                  _tables._crc32[2][(crc >> 8) & 0xff] ^
+                  _tables._crc32[1][(crc >> 16) & 0xff] ^
+                  _tables._crc32[0][crc >> 24];
+            data += 4;
+            len -= 4;
+        }
+
+        while (len--)
+        {
+            crc = (crc >> 8) ^ _tables._crc32[0][(crc ^ *data++) & 0xff];
+        }
+        return ~crc;
+    }
+};
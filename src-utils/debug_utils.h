@@ -18,24 +18,32 @@ class DebugUtils
 
 public:
     /**
-     * @brief display of EEPROM content via AT object
+     * @brief display of EEPROM content via AT object, the range is read by one
+     *        sequential read into a static buffer (the stack is too small for 4 KB)
      *
      * @param at object instance AT2432
      * @param from initial address
-     * @param num number of addresses to display
+     * @param num number of addresses to display, at most the whole memory
      */
-    static void memdump(AT2432 &at, uint16_t from, uint8_t num)
+    static void memdump(AT2432 &at, uint16_t from, uint16_t num)
     {
+        static uint8_t buf[AT2432::_memSize];
+        uint32_t len = (num < AT2432::_memSize) ? num : AT2432::_memSize;
+        if (!len || !at.readBlock(from, buf, len))
+            return;
+
         printf("\n    0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F\n");
-        for (uint16_t addr = from; addr <= (from + num); addr++)
+        for (uint32_t i = 0; i < len; i++)
         {
+            // the address counter of the chip rolls over at the end of the memory
+            uint16_t addr = (from + i) & (AT2432::_memSize - 1);
             if (addr % 16 == 0)
             {
                 printf("%02x: ", addr);
             }
 
-            printf("%02X", at.readIO(addr));
-            printf(addr % 16 == 15 ? "\n" : "  ");
+            printf("%02X", buf[i]);
+            printf(addr % 16 == 15 || i + 1 == len ? "\n" : "  ");
         }
     }
 
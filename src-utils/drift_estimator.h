@@ -0,0 +1,169 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   drift_estimator.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief drift of the local timer (time_us_64) against the DS3231 32 kHz TCXO output
+ *
+ * Each gated window gives the reference edges counted and the local microseconds
+ * elapsed. The raw drift is quantized by one edge (about 30 ppm over one second),
+ * windows of 10 s or longer and the low-pass filter bring it down to ppb.
+ * Windows far from the filtered value (missed or extra edges, counter overrun)
+ * are dropped once the filter has settled. Pure computation, no hardware access.
+ *
+ * Positive drift - the local timer runs fast.
+ */
+class DriftEstimator
+{
+public:
+    static constexpr uint32_t _refHz = 32768;
+
+public:
+    /**
+     * @brief Construct a new estimator
+     *
+     * @param shift filter weight of a new window is 1 / 2^shift
+     * @param maxStepPpb largest accepted difference of a window from the estimate
+     * @param settle windows accepted unconditionally after reset
+     */
+    explicit DriftEstimator(uint8_t shift = 3,
+                            int32_t maxStepPpb = 50000,
+                            uint8_t settle = 4) : _shift(shift),
+                                                  _maxStepPpb(maxStepPpb),
+                                                  _settle(settle)
+    {
+    }
+
+    /**
+     * @brief forgets the estimate
+     *
+     */
+    void reset()
+    {
+        _driftPpb = 0;
+        _windows = 0;
+        _rejected = 0;
+    }
+
+    /**
+     * @brief drift of a single window
+     *
+     * @param counts reference edges
+     * @param elapsedUs local time of the window
+     * @return int32_t ppb, 0 for an empty window, saturated beyond +-2 * 10^9
+     */
+    static int32_t measurePpb(uint32_t counts, uint64_t elapsedUs)
+    {
+        if (counts == 0)
+            return 0;
+
+        // reference time is counts * 10^6 / 32768 = counts * 15625 / 512 us
+        int64_t ref = (int64_t)counts * 15625;
+        int64_t diff = (int64_t)elapsedUs * 512 - ref;
+
+        // saturated, e.g. a counter overrun lies far beyond the int32 range
+        int64_t mag = (diff < 0) ? -diff : diff;
+        if (mag / 2 >= ref)
+            return (diff < 0) ? INT32_MIN : INT32_MAX;
+
+        // diff * 10^9 has to fit, long windows are scaled down
+        while (mag >= (1ll << 33))
+        {
+            diff /= 2;
+            ref /= 2;
+            mag /= 2;
+        }
+        return (int32_t)(diff * 1000000000 / ref);
+    }
+
+    /**
+     * @brief adds a measured window
+     *
+     * @param counts reference edges
+     * @param elapsedUs local time of the window
+     * @return true - accepted
+     * @return false - rejected as an outlier
+     */
+    bool addWindow(uint32_t counts, uint64_t elapsedUs)
+    {
+        if (counts == 0)
+        {
+            _rejected++;
+            return false;
+        }
+
+        int32_t ppb = measurePpb(counts, elapsedUs);
+        if (_windows == 0)
+        {
+            _driftPpb = ppb;
+        }
+        else
+        {
+            int64_t delta = (int64_t)ppb - _driftPpb;
+            if (_windows >= _settle && (delta > _maxStepPpb || delta < -_maxStepPpb))
+            {
+                _rejected++;
+                return false;
+            }
+
+            // shorter averaging while settling
+            uint8_t shift = (_windows < _settle) ? 1 : _shift;
+            _driftPpb += delta / (1 << shift);
+        }
+
+        _windows++;
+        return true;
+    }
+
+    /**
+     * @brief filtered estimate is usable
+     *
+     */
+    bool ready() const
+    {
+        return _windows >= _settle;
+    }
+
+    int32_t driftPpb() const { return _driftPpb; }
+    float driftPpm() const { return (float)_driftPpb / 1000.0f; }
+    uint32_t windows() const { return _windows; }
+    uint32_t rejected() const { return _rejected; }
+
+    /**
+     * @brief corrects a local interval to the reference time base
+     *
+     * @param localUs interval measured by time_us_64
+     * @return int64_t true microseconds
+     */
+    int64_t toReference(int64_t localUs) const
+    {
+        return localUs - localUs * _driftPpb / 1000000000;
+    }
+
+    /**
+     * @brief local interval lasting the given true time, e.g. for sleeps
+     *
+     * @param refUs true microseconds
+     * @return int64_t interval for time_us_64
+     */
+    int64_t toLocal(int64_t refUs) const
+    {
+        return refUs + refUs * _driftPpb / 1000000000;
+    }
+
+private:
+    uint8_t _shift;
+    int32_t _maxStepPpb;
+    uint8_t _settle;
+
+    int32_t _driftPpb{0};
+    uint32_t _windows{0};
+    uint32_t _rejected{0};
+};
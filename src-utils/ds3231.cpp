@@ -13,6 +13,8 @@
 #include <ctype.h>
 #include "ds3231.h"
 
+DS3231 *DS3231::_irqInstance = nullptr;
+
 DS3231::DS3231(i2c_inst_t *i2c,
                uint8_t sda,
                uint8_t scl,
@@ -43,41 +45,220 @@ bool DS3231::init(bool initI2c)
         rc = i2c_read_blocking(_i2c, _address, &data, 1, false);
     }
 
+    if (rc > 0)
+    {
+        // cache the 12/24 mode and the status for the writes
+        hour();
+        control(false);
+    }
+
     return (rc > 0);
 }
 
 void DS3231::writeIO(uint8_t addr, const uint8_t data)
 {
-    uint8_t dta[2];
+    writeBlock(addr, &data, 1);
+}
+
+bool DS3231::writeBlock(uint8_t addr, const uint8_t *data, uint8_t len)
+{
+    // the flags of the status register change in the chip, its write goes out at once
+    bool status = addr <= _CTRL2 && addr + len > _CTRL2;
+    if (_cached && addr + len <= _regFile && !status)
+    {
+        memcpy(_shadow + addr, data, len);
+        _dirty |= ((1ul << len) - 1) << addr;
+        return true;
+    }
+    return busWrite(addr, data, len);
+}
+
+bool DS3231::busWrite(uint8_t addr, const uint8_t *data, uint8_t len)
+{
+    uint8_t dta[1 + _regFile];
+    if (len > sizeof(dta) - 1)
+        return false;
+
     dta[0] = addr;
-    dta[1] = data;
-    i2c_write_blocking(_i2c, _address, dta, 2, false);
+    memcpy(dta + 1, data, len);
+    if (i2c_write_blocking(_i2c, _address, dta, len + 1, false) != len + 1)
+        return false;
+
+    if (addr + len <= _regFile)
+    {
+        auto status = _status;
+        memcpy(_shadow + addr, data, len);
+        _dirty &= ~(((1ul << len) - 1) << addr);
+
+        // CONV is cleared by the chip, the flags written as 1 keep their value
+        if (addr <= _CTRL1 && addr + len > _CTRL1)
+            _shadow[_CTRL1] &= ~_CONV;
+        if (addr <= _CTRL2 && addr + len > _CTRL2)
+            _shadow[_CTRL2] = _status = statusAfterWrite(status, data[_CTRL2 - addr]);
+    }
+    return true;
 }
 
 uint8_t DS3231::readIO(uint8_t addr)
 {
     uint8_t data = 0;
-    i2c_write_blocking(_i2c, _address, &addr, 1, true);
-    i2c_read_blocking(_i2c, _address, &data, 1, false);
+    readBlock(addr, &data, 1);
     return data;
 }
 
+bool DS3231::readBlock(uint8_t addr, uint8_t *data, uint8_t len)
+{
+    if (_cached && addr + len <= _regFile)
+    {
+        memcpy(data, _shadow + addr, len);
+        return true;
+    }
+    return busRead(addr, data, len);
+}
+
+bool DS3231::busRead(uint8_t addr, uint8_t *data, uint8_t len)
+{
+    if (i2c_write_blocking(_i2c, _address, &addr, 1, true) != 1)
+        return false;
+    if (i2c_read_blocking(_i2c, _address, data, len, false) != len)
+        return false;
+
+    // keep the shadow coherent, local changes not committed yet win
+    for (uint8_t i = 0; i < len && addr + i < _regFile; i++)
+    {
+        if (!(_dirty & (1ul << (addr + i))))
+            _shadow[addr + i] = data[i];
+    }
+
+    // a running forced conversion is not a setting to write back
+    if (addr <= _CTRL1 && addr + len > _CTRL1)
+        _shadow[_CTRL1] &= ~_CONV;
+    return true;
+}
+
+bool DS3231::setCached(bool on)
+{
+    if (on == _cached)
+        return true;
+
+    auto rc = on ? refresh() : commit();
+    _cached = on;
+    return rc;
+}
+
+bool DS3231::refresh()
+{
+    uint8_t regs[_regFile];
+    if (!busRead(_Seconds, regs, _regFile))
+        return false;
+
+    _h12 = _shadow[_Hours] & 0b01000000;
+    _status = _shadow[_CTRL2];
+    return true;
+}
+
+bool DS3231::commit()
+{
+    bool rc = true;
+    uint8_t addr = 0;
+    while (addr < _regFile)
+    {
+        if (!(_dirty & (1ul << addr)))
+        {
+            addr++;
+            continue;
+        }
+
+        uint8_t len = 1;
+        while (addr + len < _regFile && (_dirty & (1ul << (addr + len))))
+            len++;
+
+        if (busWrite(addr, _shadow + addr, len))
+            _dirty &= ~(((1ul << len) - 1) << addr);
+        else
+            rc = false;
+
+        addr += len;
+    }
+    return rc;
+}
+
+bool DS3231::readTimeRegisters(uint8_t *regs)
+{
+    return readBlock(_Seconds, regs, _timeRegs);
+}
+
 float DS3231::temperature()
 {
-    auto val = readIO(_tempmsb);
-    float temp = float((val & 0x80) ? -((uint8_t)~val + 1) : val);
-    temp += float(readIO(_templsb) >> 6) * 0.25f;
-    return temp;
+    int16_t q = 0;
+    temperatureQ(q);
+    return float(q) * 0.25f;
+}
+
+bool DS3231::temperatureQ(int16_t &q, bool force)
+{
+    uint8_t regs[2];
+
+    if (force)
+    {
+        // a conversion started by the chip itself is as fresh as ours
+        if (!startConversion() && !(_status & _BSY))
+            return false;
+        if (!waitConversion())
+            return false;
+        if (!busRead(_tempmsb, regs, 2))
+            return false;
+    }
+    else if (!readBlock(_tempmsb, regs, 2))
+    {
+        return false;
+    }
+
+    q = decodeTemperature(regs[0], regs[1]);
+    return true;
+}
+
+bool DS3231::startConversion()
+{
+    uint8_t status;
+    if (!busRead(_CTRL2, &status, 1))
+        return false;
+    _status = status;
+    if (status & _BSY)
+        return false;
+
+    // a control change not committed yet goes out with CONV
+    uint8_t ctrl = _shadow[_CTRL1];
+    if (!(_dirty & (1ul << _CTRL1)) && !busRead(_CTRL1, &ctrl, 1))
+        return false;
+    ctrl |= _CONV;
+    return busWrite(_CTRL1, &ctrl, 1);
+}
+
+bool DS3231::waitConversion(uint32_t timeoutUs)
+{
+    auto start = time_us_64();
+    uint8_t regs[2]; // control, status
+    while (busRead(_CTRL1, regs, 2))
+    {
+        _status = regs[1];
+        if (!(regs[0] & _CONV) && !(regs[1] & _BSY))
+            return true;
+        if (time_us_64() - start > timeoutUs)
+            return false;
+        sleep_ms(10);
+    }
+    return false;
 }
 
 uint8_t DS3231::num2Bcd(uint8_t val)
 {
-    return ((val / 10 * 16) + (val % 10));
+    return Bcd::encode(val);
 }
 
 uint8_t DS3231::bcd2Num(uint8_t val)
 {
-    return ((val / 16 * 10) + (val % 16));
+    return Bcd::decode(val);
 }
 
 int16_t DS3231::year()
@@ -96,11 +277,16 @@ int8_t DS3231::day()
 }
 
 int8_t DS3231::hour()
+{
+    return decodeHour(readIO(_Hours));
+}
+
+int8_t DS3231::decodeHour(uint8_t val)
 {
     int8_t rc = -1;
-    auto val = readIO(_Hours);
 
-    if (val & 0b01000000)
+    _h12 = val & 0b01000000;
+    if (_h12)
     {
         // AM/PM mode
         _pm = val & 0b00100000;
@@ -153,11 +339,14 @@ int8_t DS3231::weekDay()
 
 void DS3231::setHour(int8_t val)
 {
-    auto pmstat = readIO(_Hours);
-    if (pmstat & 0b01000000)
+    writeIO(_Hours, encodeHour(val));
+}
+
+uint8_t DS3231::encodeHour(int8_t val)
+{
+    if (_h12)
     {
         // AM/PM
-
         auto tmp = val;
         if (tmp > 11)
         {
@@ -167,12 +356,10 @@ void DS3231::setHour(int8_t val)
         {
             tmp = 12;
         }
-        writeIO(_Hours, num2Bcd(tmp) | ((pmstat & 0b01000000) << 5) | 0b01000000);
-    }
-    else
-    {
-        writeIO(_Hours, num2Bcd(val) & 0b10111111);
+        return num2Bcd(tmp) | ((val > 11) ? 0b00100000 : 0) | 0b01000000;
     }
+
+    return num2Bcd(val) & 0b10111111;
 }
 
 void DS3231::setMinute(int8_t val)
@@ -187,7 +374,10 @@ void DS3231::setSecond(int8_t val)
 
 uint8_t DS3231::control(bool first)
 {
-    return readIO(first ? _CTRL1 : _CTRL2);
+    auto val = readIO(first ? _CTRL1 : _CTRL2);
+    if (!first)
+        _status = val;
+    return val;
 }
 
 void DS3231::setControl(bool first, uint8_t val)
@@ -197,8 +387,8 @@ void DS3231::setControl(bool first, uint8_t val)
 
 void DS3231::setOSF()
 {
-    auto r = control(false);
-    setControl(false, r & 0b01111111);
+    // from the cached status, A1F/A2F written as 1 stay unchanged
+    setControl(false, (_status & 0b00001000) | 0b00000011);
 }
 
 bool DS3231::isOSF()
@@ -209,25 +399,183 @@ bool DS3231::isOSF()
 
 datetime_t DS3231::timeDate()
 {
+    uint8_t regs[_timeRegs];
+    if (!readTimeRegisters(regs))
+    {
+        datetime_t t;
+        memset(&t, 0, sizeof(datetime_t));
+        return t;
+    }
+    return decodeTime(regs);
+}
+
+datetime_t DS3231::decodeTime(const uint8_t *regs)
+{
+    // valid bits of 0x00 - 0x06, the hour is decoded separately (12/24 mode)
+    static constexpr uint8_t mask[_timeRegs] = {0x7f, 0x7f, 0x00, 0x07, 0x3f, 0x1f, 0xff};
+
+    uint8_t num[_timeRegs];
+    Bcd::decodeBlock(regs, num, _timeRegs, mask);
+
     datetime_t t = {
-        .year = year(),
-        .month = month(),
-        .day = day(),
-        .dotw = weekDay(), // 0 is Sunday
-        .hour = hour(),
-        .min = minute(),
-        .sec = second()};
+        .year = (int16_t)(2000 + num[_Year]),
+        .month = (int8_t)num[_Month],
+        .day = (int8_t)num[_Date],
+        .dotw = (int8_t)(num[_Day] - 1), // 0 is Sunday
+        .hour = decodeHour(regs[_Hours]),
+        .min = (int8_t)num[_Minutes],
+        .sec = (int8_t)num[_Seconds]};
     return t;
 }
 
+void DS3231::encodeTime(const datetime_t &dt, uint8_t *regs)
+{
+    regs[_Seconds] = (uint8_t)dt.sec;
+    regs[_Minutes] = (uint8_t)dt.min;
+    regs[_Hours] = 0;
+    regs[_Day] = (uint8_t)(dt.dotw + 1); // 1 equals Sunday
+    regs[_Date] = (uint8_t)dt.day;
+    regs[_Month] = (uint8_t)dt.month;
+    regs[_Year] = (uint8_t)((dt.year > 99) ? (dt.year - 2000) : dt.year);
+    Bcd::encodeBlock(regs, regs, _timeRegs);
+    regs[_Hours] = encodeHour(dt.hour);
+}
+
 void DS3231::setDateTime(datetime_t &dt)
 {
-    setHour(dt.hour);
-    setMinute(dt.min);
-    setSecond(dt.sec);
-    setDay(dt.day);
-    setMonth(dt.month);
-    setYear(dt.year);
-    setWeekDay(dt.dotw);
+    uint8_t regs[_timeRegs];
+    encodeTime(dt, regs);
+    writeBlock(_Seconds, regs, _timeRegs);
     setOSF();
 }
+
+bool DS3231::setAlarm(DS3231Alarm::Alarm alarm, const DS3231Alarm::Setting &s)
+{
+    uint8_t regs[4];
+    if (!DS3231Alarm::encode(alarm, s, regs))
+        return false;
+
+    return writeBlock((alarm == DS3231Alarm::Alarm::A1) ? _AM1S : _AM2M, regs, DS3231Alarm::size(alarm));
+}
+
+void DS3231::enableAlarm(DS3231Alarm::Alarm alarm, bool on)
+{
+    setControl(true, DS3231Alarm::enable(control(true), alarm, on));
+}
+
+bool DS3231::alarmFired(DS3231Alarm::Alarm alarm)
+{
+    return DS3231Alarm::fired(control(false), alarm);
+}
+
+void DS3231::clearAlarm(DS3231Alarm::Alarm alarm)
+{
+    // EN32kHz from the chip, even in the cached mode
+    uint8_t status;
+    if (!busRead(_CTRL2, &status, 1))
+        return;
+    _status = status;
+
+    uint8_t clr = DS3231Alarm::clear(status, alarm);
+    busWrite(_CTRL2, &clr, 1);
+}
+
+void DS3231::setAgingOffset(int8_t val)
+{
+    // written through even in the cached mode, the conversion has to see it
+    uint8_t reg = (uint8_t)val;
+    if (busWrite(_Aging, &reg, 1))
+        startConversion();
+}
+
+int8_t DS3231::agingOffset()
+{
+    return (int8_t)readIO(_Aging);
+}
+
+void DS3231::setSquareWave(SquareWave rate)
+{
+    auto ctrl = control(true) & ~(0b00011000 | DS3231Alarm::_INTCN);
+    setControl(true, ctrl | ((uint8_t)rate << 3));
+}
+
+void DS3231::enable32kHz(bool on)
+{
+    auto status = control(false);
+    status = on ? (status | DS3231Alarm::_EN32kHz) : (status & ~DS3231Alarm::_EN32kHz);
+
+    // OSF as read, A1F/A2F written as 1 stay unchanged
+    writeIO(_CTRL2, status | DS3231Alarm::_A2F | DS3231Alarm::_A1F);
+}
+
+void DS3231::attachInterrupt(uint gpio, AlarmCallback cb, void *ctx)
+{
+    _irqInstance = this;
+    _irqGpio = gpio;
+    _alarmCb = cb;
+    _alarmCtx = ctx;
+    _irqPending = false;
+
+    // INT/SQW is open drain
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_up(gpio);
+    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_FALL, true, &DS3231::gpioIrq);
+}
+
+void DS3231::gpioIrq(uint gpio, uint32_t events)
+{
+    // only marks the event, I2C is left to the main loop
+    if (_irqInstance && gpio == _irqInstance->_irqGpio && (events & GPIO_IRQ_EDGE_FALL))
+    {
+        _irqInstance->_irqPending = true;
+    }
+}
+
+bool DS3231::service()
+{
+    if (!_irqPending)
+        return false;
+    _irqPending = false;
+
+    const DS3231Alarm::Alarm alarms[] = {DS3231Alarm::Alarm::A1, DS3231Alarm::Alarm::A2};
+    bool rc = false;
+    for (uint8_t pass = 0; pass < _servicePasses; pass++)
+    {
+        // the flags always from the chip, even in the cached mode
+        uint8_t status;
+        if (!busRead(_CTRL2, &status, 1))
+            break;
+        _status = status;
+
+        if (!(status & (DS3231Alarm::_A1F | DS3231Alarm::_A2F)))
+        {
+            // INT is released with the last flag, the next flag gives a new edge
+            _irqPending = !gpio_get(_irqGpio);
+            return rc;
+        }
+
+        for (auto alarm : alarms)
+        {
+            if (!DS3231Alarm::fired(status, alarm))
+                continue;
+
+            // the other flag is written as 1, it stays even if it was set meanwhile
+            uint8_t clr = DS3231Alarm::clear(status, alarm);
+            if (!busWrite(_CTRL2, &clr, 1))
+            {
+                _irqPending = true;
+                return rc;
+            }
+            status &= ~DS3231Alarm::flag(alarm);
+
+            if (_alarmCb)
+                _alarmCb(_alarmCtx, alarm);
+            rc = true;
+        }
+    }
+
+    // bus error, or the flags keep coming - the next service() goes on
+    _irqPending = true;
+    return rc;
+}
@@ -10,10 +10,15 @@
 #include <inttypes.h>
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
+#include "ds3231_alarm.h"
+#include "bcd.h"
 
 /**
  * @brief - encapsulates the basic real-time control clock
  *        - Basically it works with 0 - 24 hour cycle.
+ *        - Keeps a shadow copy of the register file 0x00 - 0x12. In the cached mode
+ *          all accessors work on the shadow, refresh() / commit() sync it in bursts.
+ *          Writes of the status register and the aging offset go to the chip at once.
  */
 class DS3231
 {
@@ -40,10 +45,40 @@ public:
 
     static constexpr uint8_t _CTRL1 = 0x0E;
     static constexpr uint8_t _CTRL2 = 0x0F;
+    static constexpr uint8_t _Aging = 0x10;
 
     static constexpr uint8_t _tempmsb = 0x11;
     static constexpr uint8_t _templsb = 0x12;
 
+    static constexpr uint8_t _CONV = 0b00100000;  // control, force a temperature conversion
+    static constexpr uint8_t _BSY = 0b00000100;   // status, TCXO conversion running
+
+    static constexpr uint32_t _convTimeoutUs = 250000; // conversion takes up to 200 ms
+    static constexpr uint8_t _servicePasses = 4;        // flag reads per service()
+
+    static constexpr uint8_t _timeRegs = 7;  // 0x00 - 0x06
+    static constexpr uint8_t _regFile = 19;  // 0x00 - 0x12
+
+    /**
+     * @brief alarm callback, called from service()
+     *
+     * @param ctx user context
+     * @param alarm alarm which fired
+     */
+    using AlarmCallback = void (*)(void *ctx, DS3231Alarm::Alarm alarm);
+
+    /**
+     * @brief frequency of the INT/SQW output (RS2, RS1)
+     *
+     */
+    enum class SquareWave : uint8_t
+    {
+        Hz1 = 0,
+        Hz1024 = 1,
+        Hz4096 = 2,
+        Hz8192 = 3
+    };
+
 public:
     /**
      * @brief Construct a new DS3231 object
@@ -175,6 +210,45 @@ public:
      */
     float temperature();
 
+    /**
+     * @brief reads the temperature registers in one burst
+     *
+     * @param q [out] temperature in quarter-degrees Celsius
+     * @param force true - runs a fresh conversion first and reads the chip even in cached mode
+     * @return true - success
+     * @return false - bus error or the conversion did not finish
+     */
+    bool temperatureQ(int16_t &q, bool force = false);
+
+    /**
+     * @brief forces a temperature conversion (CONV), does not wait for it
+     *
+     * @return true - conversion started
+     * @return false - a conversion is already running (BSY) or bus error
+     */
+    bool startConversion();
+
+    /**
+     * @brief waits until the forced conversion finishes (CONV cleared by the chip)
+     *
+     * @param timeoutUs - max. waiting time
+     * @return true - finished
+     * @return false - timeout or bus error
+     */
+    bool waitConversion(uint32_t timeoutUs = _convTimeoutUs);
+
+    /**
+     * @brief converts the raw temperature registers, 10 bit two's complement
+     *
+     * @param msb - register 0x11
+     * @param lsb - register 0x12
+     * @return int16_t quarter-degrees Celsius
+     */
+    static int16_t decodeTemperature(uint8_t msb, uint8_t lsb)
+    {
+        return (int16_t)((int8_t)msb * 4 + (lsb >> 6));
+    }
+
     /**
      * @brief Set the Control register
      *
@@ -191,6 +265,103 @@ public:
      */
     uint8_t control(bool first);
 
+    /**
+     * @brief programs the alarm registers in one burst
+     *
+     * @param alarm alarm number
+     * @param s match mode and values
+     * @return true - success
+     * @return false - mode not supported by the alarm or bus error
+     */
+    bool setAlarm(DS3231Alarm::Alarm alarm, const DS3231Alarm::Setting &s);
+
+    /**
+     * @brief enables / disables the alarm interrupt, INT/SQW switches to the interrupt output
+     *
+     * @param alarm alarm number
+     * @param on enable
+     */
+    void enableAlarm(DS3231Alarm::Alarm alarm, bool on);
+
+    /**
+     * @brief reads the alarm flag
+     *
+     * @param alarm alarm number
+     * @return true - the alarm fired
+     */
+    bool alarmFired(DS3231Alarm::Alarm alarm);
+
+    /**
+     * @brief clears the alarm flag, releases INT
+     *
+     * @param alarm alarm number
+     */
+    void clearAlarm(DS3231Alarm::Alarm alarm);
+
+    /**
+     * @brief connects the INT/SQW pin, a falling edge marks the alarm as pending
+     *        Only one instance can be attached, the GPIO IRQ callback is global.
+     *
+     * @param gpio pin connected to INT/SQW
+     * @param cb callback for the fired alarms
+     * @param ctx user context for the callback
+     */
+    void attachInterrupt(uint gpio, AlarmCallback cb, void *ctx = nullptr);
+
+    /**
+     * @brief is an interrupt waiting for service()
+     *
+     * @return true - pending
+     */
+    bool pending() const
+    {
+        return _irqPending;
+    }
+
+    /**
+     * @brief handles the pending interrupt - reads the flags, clears them and calls the callback,
+     *        to be called from the main loop (e.g. after __wfi())
+     *
+     * The flags are read again until none is set, INT gives no new edge while it is low.
+     * On a bus error, or with INT still low, the interrupt stays pending.
+     *
+     * @return true - an alarm was dispatched
+     * @return false - nothing pending, or a bus error before the dispatch
+     */
+    bool service();
+
+    /**
+     * @brief sets the aging offset register, about 0.1 ppm per LSB,
+     *        positive values slow the oscillator down, a conversion is
+     *        forced so the new value applies immediately
+     *
+     * @param val two's complement offset
+     */
+    void setAgingOffset(int8_t val);
+
+    /**
+     * @brief reads the aging offset register
+     *
+     * @return int8_t
+     */
+    int8_t agingOffset();
+
+    /**
+     * @brief switches INT/SQW to the square wave output (INTCN = 0), alarm interrupts
+     *        are not signalled on the pin then
+     *
+     * @param rate frequency
+     */
+    void setSquareWave(SquareWave rate);
+
+    /**
+     * @brief enables the 32kHz output (EN32kHz), the TCXO reference for the drift
+     *        measurement, OSF and the alarm flags are kept
+     *
+     * @param on
+     */
+    void enable32kHz(bool on);
+
     /**
      * @brief oscillator either is stopped or was stopped for some period and may be used to judge the validity of the timekeeping data
      *
@@ -221,6 +392,98 @@ public:
      */
     uint8_t readIO(uint8_t addr);
 
+    /**
+     * @brief cached mode - reads and writes of the registers go to the shadow copy
+     *
+     * @param on true - enable, refreshes the shadow; false - disable, commits the shadow
+     * @return true - success
+     * @return false - bus error
+     */
+    bool setCached(bool on);
+
+    /**
+     * @brief is the cached mode active
+     *
+     * @return true - accessors work on the shadow copy
+     */
+    bool cached() const
+    {
+        return _cached;
+    }
+
+    /**
+     * @brief reloads the shadow copy in one 19 byte burst, dirty registers are kept
+     *
+     * @return true - success
+     * @return false - bus error
+     */
+    bool refresh();
+
+    /**
+     * @brief writes the dirty registers, one burst for each contiguous dirty range
+     *
+     * @return true - success
+     * @return false - bus error, failed registers stay dirty
+     */
+    bool commit();
+
+    /**
+     * @brief is any register of the shadow copy modified and not committed
+     *
+     * @return true - commit() needed
+     */
+    bool dirty() const
+    {
+        return _dirty != 0;
+    }
+
+    /**
+     * @brief burst read of consecutive registers - from the shadow in the cached mode
+     *
+     * @param addr - first register address
+     * @param data [out] - register values
+     * @param len - number of registers
+     * @return true - success
+     * @return false - bus error
+     */
+    bool readBlock(uint8_t addr, uint8_t *data, uint8_t len);
+
+    /**
+     * @brief burst write of consecutive registers - into the shadow in the cached mode
+     *
+     * @param addr - first register address
+     * @param data - register values
+     * @param len - number of registers
+     * @return true - success
+     * @return false - bus error
+     */
+    bool writeBlock(uint8_t addr, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief encodes the time into the raw time registers, the 12/24 mode is kept
+     *
+     * @param dt - datetime
+     * @param regs [out] - raw register values 0x00 - 0x06
+     */
+    void encodeTime(const datetime_t &dt, uint8_t *regs);
+
+    /**
+     * @brief reads the time registers 0x00 - 0x06 in one burst, consistent snapshot
+     *
+     * @param regs [out] - raw register values, _timeRegs long
+     * @return true - success
+     * @return false - bus error
+     */
+    bool readTimeRegisters(uint8_t *regs);
+
+    /**
+     * @brief decodes the raw time registers
+     *
+     * @param regs - raw register values 0x00 - 0x06
+     * @return datetime_t
+     */
+    datetime_t decodeTime(const uint8_t *regs);
+
     /**
      * @brief converts a number to a BCD representation
      *
@@ -238,23 +501,84 @@ public:
     uint8_t bcd2Num(uint8_t val);
 
     /**
-     * @brief gets datetime into struct
+     * @brief gets datetime into struct - one burst read of all time registers
      * 
      * @return datetime_t 
      */
     datetime_t timeDate();
 
     /**
-     * @brief RTC with datetime struct
+     * @brief RTC with datetime struct - one burst write of the time registers
+     *        and the OSF clear, the clock is set atomically
      * 
      * @param dt 
      */
     void setDateTime(datetime_t& dt);
 
 private:
+    /**
+     * @brief burst read from the chip, updates the shadow
+     *
+     */
+    bool busRead(uint8_t addr, uint8_t *data, uint8_t len);
+
+    /**
+     * @brief burst write to the chip, updates the shadow
+     *
+     */
+    bool busWrite(uint8_t addr, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief status register after a write - OSF, A1F and A2F written as 1
+     *        keep their value, BSY is read only
+     *
+     * @param status - status before the write
+     * @param val - value written
+     * @return uint8_t
+     */
+    static constexpr uint8_t statusAfterWrite(uint8_t status, uint8_t val)
+    {
+        constexpr uint8_t flags = DS3231Alarm::_OSF | DS3231Alarm::_A2F | DS3231Alarm::_A1F;
+        return (val & ~(flags | _BSY)) | (status & ((val & flags) | _BSY));
+    }
+
+    /**
+     * @brief decodes the hours register, 12/24 mode aware
+     *
+     * @param val - register value
+     * @return int8_t 0 - 23 / 1 - 12
+     */
+    int8_t decodeHour(uint8_t val);
+
+    /**
+     * @brief encodes the hours register in the cached 12/24 mode
+     *
+     * @param val - 0 - 23
+     * @return uint8_t - register value
+     */
+    uint8_t encodeHour(int8_t val);
+
+    /**
+     * @brief GPIO IRQ handler
+     *
+     */
+    static void gpioIrq(uint gpio, uint32_t events);
+
+private:
+    static DS3231 *_irqInstance;
+
     i2c_inst_t *_i2c{nullptr};
     uint8_t _sda{0};
     uint8_t _scl{0};
     uint8_t _address{0};
     bool _pm{false};
+    bool _h12{false};       // 12 hour mode, cached from the hours register
+    uint8_t _status{0x08};  // cached status register, EN32kHz set after power on
+    uint8_t _shadow[_regFile]{};
+    uint32_t _dirty{0};     // bit per register of the shadow
+    bool _cached{false};
+    volatile bool _irqPending{false};
+    uint _irqGpio{0};
+    AlarmCallback _alarmCb{nullptr};
+    void *_alarmCtx{nullptr};
 };
@@ -0,0 +1,240 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   ds3231_alarm.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief register level logic of the DS3231 alarms
+ *
+ * Pure functions over raw register values, so the encoding and the match logic
+ * of the chip can be checked against a simulated register file.
+ *
+ *  Alarm 1 (0x07 - 0x0A)  A1M4 A1M3 A1M2 A1M1  DY/DT
+ *  Alarm 2 (0x0B - 0x0D)  A2M4 A2M3 A2M2       DY/DT   (seconds always 00)
+ */
+class DS3231Alarm
+{
+public:
+    /**
+     * @brief alarm number
+     *
+     */
+    enum class Alarm : uint8_t
+    {
+        A1 = 1,
+        A2 = 2
+    };
+
+    /**
+     * @brief what has to match for the alarm
+     *
+     */
+    enum class Mode : uint8_t
+    {
+        EverySecond, // alarm 1 only
+        EveryMinute, // at seconds 00
+        Second,      // seconds, alarm 1 only
+        Minute,      // minutes (and seconds for alarm 1)
+        Hour,        // hours, minutes (and seconds)
+        Date,        // date, hours, minutes (and seconds)
+        WeekDay      // day of week, hours, minutes (and seconds)
+    };
+
+    /**
+     * @brief alarm definition
+     *
+     */
+    struct Setting
+    {
+        Mode _mode;
+        int8_t _sec;  // 0 - 59, alarm 1 only
+        int8_t _min;  // 0 - 59
+        int8_t _hour; // 0 - 23
+        int8_t _day;  // date 1 - 31 or day of week 0 - 6, 0 is Sunday
+    };
+
+    // control register 0x0E
+    static constexpr uint8_t _INTCN = 0b00000100;
+    static constexpr uint8_t _A2IE = 0b00000010;
+    static constexpr uint8_t _A1IE = 0b00000001;
+
+    // status register 0x0F
+    static constexpr uint8_t _OSF = 0b10000000;
+    static constexpr uint8_t _EN32kHz = 0b00001000;
+    static constexpr uint8_t _A2F = 0b00000010;
+    static constexpr uint8_t _A1F = 0b00000001;
+
+    // alarm registers
+    static constexpr uint8_t _AxMx = 0b10000000;
+    static constexpr uint8_t _DYDT = 0b01000000;
+
+    /**
+     * @brief number of alarm registers
+     *
+     * @param alarm alarm number
+     * @return uint8_t 4 or 3
+     */
+    static constexpr uint8_t size(Alarm alarm)
+    {
+        return (alarm == Alarm::A1) ? 4 : 3;
+    }
+
+    /**
+     * @brief encodes the setting into the alarm registers
+     *
+     * @param alarm alarm number
+     * @param s setting
+     * @param regs [out] size(alarm) registers starting at 0x07 or 0x0B
+     * @return true - valid
+     * @return false - mode not supported by the alarm
+     */
+    static bool encode(Alarm alarm, const Setting &s, uint8_t *regs)
+    {
+        // mask bits M1 (seconds) .. M4 (day), set bit = "don't care"
+        uint8_t mask;
+        switch (s._mode)
+        {
+        case Mode::EverySecond:
+            mask = 0b1111;
+            break;
+        case Mode::EveryMinute:
+            mask = 0b1110;
+            break;
+        case Mode::Second:
+            mask = 0b1110;
+            break;
+        case Mode::Minute:
+            mask = 0b1100;
+            break;
+        case Mode::Hour:
+            mask = 0b1000;
+            break;
+        default:
+            mask = 0b0000;
+            break;
+        }
+
+        uint8_t sec = (s._mode == Mode::EveryMinute) ? 0 : s._sec;
+        uint8_t day = (s._mode == Mode::WeekDay) ? (bcd(s._day + 1) | _DYDT) : bcd(s._day);
+
+        if (alarm == Alarm::A1)
+        {
+            regs[0] = bcd(sec) | ((mask & 0b0001) ? _AxMx : 0);
+            regs[1] = bcd(s._min) | ((mask & 0b0010) ? _AxMx : 0);
+            regs[2] = bcd(s._hour) | ((mask & 0b0100) ? _AxMx : 0);
+            regs[3] = day | ((mask & 0b1000) ? _AxMx : 0);
+            return true;
+        }
+
+        // alarm 2 has no seconds, it fires at 00
+        if (s._mode == Mode::EverySecond || s._mode == Mode::Second)
+            return false;
+
+        regs[0] = bcd(s._min) | ((mask & 0b0010) ? _AxMx : 0);
+        regs[1] = bcd(s._hour) | ((mask & 0b0100) ? _AxMx : 0);
+        regs[2] = day | ((mask & 0b1000) ? _AxMx : 0);
+        return true;
+    }
+
+    /**
+     * @brief control register with the alarm interrupt enabled / disabled, INTCN is set
+     *
+     * @param ctrl control register value
+     * @param alarm alarm number
+     * @param on interrupt enable
+     * @return uint8_t new control register value
+     */
+    static constexpr uint8_t enable(uint8_t ctrl, Alarm alarm, bool on)
+    {
+        uint8_t bit = (alarm == Alarm::A1) ? _A1IE : _A2IE;
+        return (on ? (ctrl | bit) : (ctrl & ~bit)) | _INTCN;
+    }
+
+    /**
+     * @brief flag bit of the alarm in the status register
+     *
+     * @param alarm alarm number
+     */
+    static constexpr uint8_t flag(Alarm alarm)
+    {
+        return (alarm == Alarm::A1) ? _A1F : _A2F;
+    }
+
+    /**
+     * @brief is the alarm flag set
+     *
+     * @param status status register value
+     * @param alarm alarm number
+     */
+    static constexpr bool fired(uint8_t status, Alarm alarm)
+    {
+        return status & flag(alarm);
+    }
+
+    /**
+     * @brief status register value that clears the alarm flag, OSF and the other flag
+     *        are written as 1 (unchanged, even if set after the status was read),
+     *        EN32kHz is kept
+     *
+     * @param status status register value
+     * @param alarm alarm number
+     * @return uint8_t value to write
+     */
+    static constexpr uint8_t clear(uint8_t status, Alarm alarm)
+    {
+        return (status & _EN32kHz) | _OSF | ((alarm == Alarm::A1) ? _A2F : _A1F);
+    }
+
+    /**
+     * @brief model of the chip - does the current time match the alarm
+     *
+     * @param time time registers 0x00 - 0x06
+     * @param regs alarm registers of the alarm
+     * @param alarm alarm number
+     * @return true - the chip sets the flag in this second
+     */
+    static bool matches(const uint8_t *time, const uint8_t *regs, Alarm alarm)
+    {
+        uint8_t sec, min, hour, day;
+        if (alarm == Alarm::A1)
+        {
+            sec = regs[0];
+            min = regs[1];
+            hour = regs[2];
+            day = regs[3];
+        }
+        else
+        {
+            sec = 0; // seconds 00, always compared
+            min = regs[0];
+            hour = regs[1];
+            day = regs[2];
+        }
+
+        if (!(sec & _AxMx) && (sec & 0x7f) != time[0])
+            return false;
+        if (!(min & _AxMx) && (min & 0x7f) != time[1])
+            return false;
+        if (!(hour & _AxMx) && (hour & 0x3f) != (time[2] & 0x3f))
+            return false;
+        if (!(day & _AxMx))
+        {
+            if (day & _DYDT)
+                return (day & 0x0f) == time[3];
+            return (day & 0x3f) == time[4];
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint8_t bcd(uint8_t val)
+    {
+        return ((val / 10) << 4) | (val % 10);
+    }
+};
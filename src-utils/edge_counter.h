@@ -0,0 +1,130 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   edge_counter.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <hardware/pwm.h>
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+/**
+ * @brief pwm-based counter of rising edges over a gated window, timed by time_us_64
+ *
+ * The pwm slice counts edges of its B input, so the pin has to be odd.
+ * The hardware counter is 16 bit, update() has to run at least once per
+ * 65536 edges (2 s of the DS3231 32 kHz output).
+ */
+class EdgeCounter
+{
+
+public:
+
+    /**
+     * @brief Construct a new EdgeCounter
+     *
+     * @param pin - pin assigment, pwm channel B
+     */
+    EdgeCounter(uint8_t pin) : _pin(pin)
+    {
+    }
+
+    /**
+     * @brief pwm initialization for a given pin
+     *
+     * @return true
+     * @return false - the pin is not a pwm B input
+     */
+    bool init()
+    {
+        if (pwm_gpio_to_channel(_pin) != PWM_CHAN_B)
+            return false;
+
+        _slice = pwm_gpio_to_slice_num(_pin);
+        pwm_config cfg = pwm_get_default_config();
+        pwm_config_set_clkdiv_mode(&cfg, PWM_DIV_B_RISING);
+        pwm_config_set_clkdiv_int(&cfg, 1);
+        pwm_init(_slice, &cfg, false);
+        gpio_set_function(_pin, GPIO_FUNC_PWM);
+        pwm_set_enabled(_slice, true);
+        return true;
+    }
+
+    /**
+     * @brief opens a new window
+     *
+     */
+    void start()
+    {
+        sample(_last, _startUs);
+        _lastUs = _startUs;
+        _counts = 0;
+    }
+
+    /**
+     * @brief extends the counter, call at least every second
+     *
+     */
+    void update()
+    {
+        uint16_t cnt;
+        sample(cnt, _lastUs);
+        _counts += (uint16_t)(cnt - _last);
+        _last = cnt;
+    }
+
+    /**
+     * @brief window state of the last update()
+     *
+     * @param counts [out] edges since start()
+     * @param elapsedUs [out] local time since start()
+     */
+    void window(uint32_t &counts, uint64_t &elapsedUs) const
+    {
+        counts = _counts;
+        elapsedUs = _lastUs - _startUs;
+    }
+
+    /**
+     * @brief blocking measurement of one window
+     *
+     * @param windowUs window length
+     * @param counts [out] edges
+     * @param elapsedUs [out] exact local time of the window
+     */
+    void measure(uint32_t windowUs, uint32_t &counts, uint64_t &elapsedUs)
+    {
+        start();
+        do
+        {
+            sleep_ms(500);
+            update();
+        } while (_lastUs - _startUs < windowUs);
+        window(counts, elapsedUs);
+    }
+
+private:
+    /**
+     * @brief counter and timer read back to back
+     *
+     */
+    void sample(uint16_t &cnt, uint64_t &us)
+    {
+        auto irq = save_and_disable_interrupts();
+        cnt = (uint16_t)pwm_get_counter(_slice);
+        us = time_us_64();
+        restore_interrupts(irq);
+    }
+
+private:
+    uint8_t _pin{0};
+    uint _slice{0};
+    uint16_t _last{0};
+    uint32_t _counts{0};
+    uint64_t _startUs{0};
+    uint64_t _lastUs{0};
+};
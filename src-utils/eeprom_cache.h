@@ -0,0 +1,263 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_cache.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+
+/**
+ * @brief write-back RAM page cache in front of a serial EEPROM (AT2432 or EepromSim)
+ *
+ * Holds whole pages, reads are served from RAM and writes are merged in the frame
+ * until flush() or eviction. A dirty page goes out as one page write.
+ * The least recently used frame is evicted. Addresses roll over at the end
+ * of the memory like the address counter of the chip.
+ *
+ * @tparam Storage - device with readBlock / writeBlock, _pageSize and _memSize
+ * @tparam Frames - number of page frames
+ */
+template <class Storage, uint8_t Frames = 4>
+class EepromCache
+{
+    static_assert(Frames > 0, "at least one frame");
+
+public:
+    static constexpr uint16_t _pageSize = Storage::_pageSize;
+    static constexpr uint16_t _memSize = Storage::_memSize;
+
+    /**
+     * @brief cache counters, for sizing
+     *
+     */
+    struct Stats
+    {
+        uint32_t _hits;      // page found in a frame
+        uint32_t _misses;    // page loaded from the chip
+        uint32_t _flushes;   // dirty pages written to the chip
+        uint32_t _evictions; // frames reused for another page
+    };
+
+public:
+    /**
+     * @brief Construct a new cache
+     *
+     * @param storage EEPROM instance
+     */
+    explicit EepromCache(Storage &storage) : _storage(storage)
+    {
+        invalidate();
+    }
+
+    /**
+     * @brief reads the data through the cache
+     *
+     * @param addr memory location address
+     * @param data [out] buffer
+     * @param len length
+     * @return true - success
+     * @return false - chip access failed
+     */
+    bool read(uint16_t addr, uint8_t *data, uint16_t len)
+    {
+        addr &= (_memSize - 1);
+        while (len)
+        {
+            auto chunk = pageChunk(addr, len);
+            auto f = frame(addr / _pageSize, true);
+            if (!f)
+                return false;
+
+            memcpy(data, f->_data + (addr % _pageSize), chunk);
+            addr = (addr + chunk) & (_memSize - 1);
+            data += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief writes the data into the cache, the chip is updated by flush() or eviction
+     *
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length
+     * @return true - success
+     * @return false - chip access failed
+     */
+    bool write(uint16_t addr, const uint8_t *data, uint16_t len)
+    {
+        addr &= (_memSize - 1);
+        while (len)
+        {
+            auto chunk = pageChunk(addr, len);
+
+            // a full page does not need to be loaded
+            auto f = frame(addr / _pageSize, chunk != _pageSize);
+            if (!f)
+                return false;
+
+            memcpy(f->_data + (addr % _pageSize), data, chunk);
+            f->_dirty = true;
+            addr = (addr + chunk) & (_memSize - 1);
+            data += chunk;
+            len -= chunk;
+        }
+        return true;
+    }
+
+    /**
+     * @brief reads the octet through the cache
+     *
+     * @param addr memory location address
+     * @return uint8_t - octet value
+     */
+    uint8_t readIO(uint16_t addr)
+    {
+        uint8_t data = 0;
+        read(addr, &data, 1);
+        return data;
+    }
+
+    /**
+     * @brief writes the octet into the cache
+     *
+     * @param addr memory location address
+     * @param data octet value
+     */
+    void writeIO(uint16_t addr, const uint8_t data)
+    {
+        write(addr, &data, 1);
+    }
+
+    /**
+     * @brief writes all dirty pages to the chip, one page write each
+     *
+     * @return true - success
+     * @return false - chip access failed, the failed pages stay dirty
+     */
+    bool flush()
+    {
+        bool rc = true;
+        for (auto &f : _frames)
+        {
+            if (!flushFrame(f))
+                rc = false;
+        }
+        return rc;
+    }
+
+    /**
+     * @brief drops all frames without writing them
+     *
+     */
+    void invalidate()
+    {
+        for (auto &f : _frames)
+        {
+            f._valid = false;
+            f._dirty = false;
+            f._stamp = 0;
+        }
+    }
+
+    /**
+     * @brief number of dirty frames
+     *
+     * @return uint8_t
+     */
+    uint8_t dirty() const
+    {
+        uint8_t rc = 0;
+        for (auto &f : _frames)
+        {
+            if (f._valid && f._dirty)
+                rc++;
+        }
+        return rc;
+    }
+
+    const Stats &stats() const { return _stats; }
+    void clearStats() { memset(&_stats, 0, sizeof(_stats)); }
+
+private:
+    struct Frame
+    {
+        uint16_t _page;
+        uint32_t _stamp; // last use, for LRU
+        bool _valid;
+        bool _dirty;
+        uint8_t _data[_pageSize];
+    };
+
+    static uint16_t pageChunk(uint16_t addr, uint16_t len)
+    {
+        uint16_t room = _pageSize - (addr % _pageSize);
+        return (len < room) ? len : room;
+    }
+
+    bool flushFrame(Frame &f)
+    {
+        if (!f._valid || !f._dirty)
+            return true;
+
+        if (!_storage.writeBlock(f._page * _pageSize, f._data, _pageSize))
+            return false;
+
+        f._dirty = false;
+        _stats._flushes++;
+        return true;
+    }
+
+    /**
+     * @brief finds the frame holding the page, or evicts the LRU frame for it
+     *
+     * @param page page number
+     * @param load true - read the page content from the chip on miss
+     * @return Frame* - nullptr on failure
+     */
+    Frame *frame(uint16_t page, bool load)
+    {
+        Frame *victim = &_frames[0];
+        for (auto &f : _frames)
+        {
+            if (f._valid && f._page == page)
+            {
+                f._stamp = ++_clock;
+                _stats._hits++;
+                return &f;
+            }
+
+            if (!f._valid || (victim->_valid && f._stamp < victim->_stamp))
+                victim = &f;
+        }
+
+        _stats._misses++;
+        if (victim->_valid)
+        {
+            if (!flushFrame(*victim))
+                return nullptr;
+            _stats._evictions++;
+        }
+
+        victim->_valid = false;
+        if (load && !_storage.readBlock(page * _pageSize, victim->_data, _pageSize))
+            return nullptr;
+
+        victim->_page = page;
+        victim->_valid = true;
+        victim->_dirty = false;
+        victim->_stamp = ++_clock;
+        return victim;
+    }
+
+private:
+    Storage &_storage;
+    Frame _frames[Frames];
+    uint32_t _clock{0};
+    Stats _stats{};
+};
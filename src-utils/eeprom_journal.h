@@ -0,0 +1,215 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_journal.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include "crc.h"
+
+/**
+ * @brief append-only record journal on a serial EEPROM (AT2432 or EepromSim)
+ *
+ * Fixed-size records are written round-robin over the region, so every slot wears
+ * equally. Each slot holds a sequence number, the payload and a CRC:
+ *
+ *   | seq (4, LE) | payload (SlotSize - 6) | crc16 (2, LE) |
+ *
+ * The slot size divides the page size, so an append is exactly one page write.
+ * Sequence numbers in slots 0..head are consecutive, which allows to find the head
+ * by binary search when mounting.
+ *
+ * @tparam Storage - device with readBlock / writeBlock and _pageSize
+ * @tparam SlotSize - size of the record slot including the header and CRC
+ */
+template <class Storage, uint16_t SlotSize = 16>
+class EepromJournal
+{
+    static_assert(SlotSize > 6, "slot too small");
+    static_assert(Storage::_pageSize % SlotSize == 0, "slot must not straddle a page");
+
+public:
+    static constexpr uint16_t _slotSize = SlotSize;
+    static constexpr uint16_t _payloadSize = SlotSize - 6;
+    static constexpr uint32_t _erased = 0xffffffff;
+
+public:
+    /**
+     * @brief Construct a new journal over the region
+     *
+     * @param storage EEPROM instance
+     * @param base first address of the region, page aligned
+     * @param length length of the region in bytes
+     */
+    EepromJournal(Storage &storage,
+                  uint16_t base,
+                  uint16_t length) : _storage(storage),
+                                     _base(base),
+                                     _slots(length / SlotSize)
+    {
+    }
+
+    /**
+     * @brief finds the newest record, O(log n) slot reads
+     *
+     * @return true - journal contains records
+     * @return false - empty journal
+     */
+    bool mount()
+    {
+        _empty = true;
+        _head = 0;
+        _seq = 0;
+
+        uint32_t seq0;
+        if (!readSeq(0, seq0))
+        {
+            // slot 0 torn at the beginning of a new lap, or the journal is empty
+            uint32_t last;
+            if (_slots > 1 && readSeq(_slots - 1, last))
+            {
+                _head = _slots - 1;
+                _seq = last;
+                _empty = false;
+            }
+            return !_empty;
+        }
+
+        // the last slot with the sequence continuing from slot 0
+        uint16_t lo = 0;
+        uint16_t hi = _slots - 1;
+        while (lo < hi)
+        {
+            uint16_t mid = lo + (hi - lo + 1) / 2;
+            uint32_t seq;
+            if (readSeq(mid, seq) && seq == seq0 + mid)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+
+        _head = lo;
+        _seq = seq0 + lo;
+        _empty = false;
+        return true;
+    }
+
+    /**
+     * @brief appends the record to the next slot
+     *
+     * @param payload record data
+     * @param len length, at most _payloadSize, the rest is zero filled
+     * @return true - written
+     * @return false - invalid length or write failed
+     */
+    bool append(const uint8_t *payload, uint16_t len)
+    {
+        if (len > _payloadSize)
+            return false;
+
+        uint16_t slot = _empty ? 0 : (_head + 1) % _slots;
+        uint32_t seq = _empty ? 1 : _seq + 1;
+
+        uint8_t rec[SlotSize];
+        memset(rec, 0, sizeof(rec));
+        putSeq(rec, seq);
+        memcpy(rec + 4, payload, len);
+        uint16_t crc = Crc::crc16(rec, SlotSize - 2);
+        rec[SlotSize - 2] = crc & 0xff;
+        rec[SlotSize - 1] = crc >> 8;
+
+        if (!_storage.writeBlock(address(slot), rec, SlotSize))
+            return false;
+
+        _head = slot;
+        _seq = seq;
+        _empty = false;
+        return true;
+    }
+
+    /**
+     * @brief reads the record
+     *
+     * @param back 0 - the newest record, 1 - the previous one ...
+     * @param payload [out] buffer of _payloadSize
+     * @return true - valid record
+     * @return false - out of range or corrupted
+     */
+    bool read(uint16_t back, uint8_t *payload)
+    {
+        if (_empty || back >= count())
+            return false;
+
+        uint16_t slot = (_head + _slots - back) % _slots;
+        uint8_t rec[SlotSize];
+        if (!readSlot(slot, rec))
+            return false;
+
+        memcpy(payload, rec + 4, _payloadSize);
+        return true;
+    }
+
+    /**
+     * @brief number of records available
+     *
+     * @return uint32_t
+     */
+    uint32_t count() const
+    {
+        return _empty ? 0 : ((_seq < _slots) ? _seq : _slots);
+    }
+
+    bool empty() const { return _empty; }
+    uint16_t head() const { return _head; }
+    uint32_t sequence() const { return _seq; }
+    uint16_t slots() const { return _slots; }
+
+private:
+    uint16_t address(uint16_t slot) const
+    {
+        return _base + slot * SlotSize;
+    }
+
+    static void putSeq(uint8_t *rec, uint32_t seq)
+    {
+        rec[0] = seq & 0xff;
+        rec[1] = (seq >> 8) & 0xff;
+        rec[2] = (seq >> 16) & 0xff;
+        rec[3] = seq >> 24;
+    }
+
+    static uint32_t getSeq(const uint8_t *rec)
+    {
+        return rec[0] | (rec[1] << 8) | (rec[2] << 16) | ((uint32_t)rec[3] << 24);
+    }
+
+    bool readSlot(uint16_t slot, uint8_t *rec)
+    {
+        if (!_storage.readBlock(address(slot), rec, SlotSize))
+            return false;
+
+        uint16_t crc = rec[SlotSize - 2] | (rec[SlotSize - 1] << 8);
+        return getSeq(rec) != _erased && crc == Crc::crc16(rec, SlotSize - 2);
+    }
+
+    bool readSeq(uint16_t slot, uint32_t &seq)
+    {
+        uint8_t rec[SlotSize];
+        if (!readSlot(slot, rec))
+            return false;
+        seq = getSeq(rec);
+        return true;
+    }
+
+private:
+    Storage &_storage;
+    uint16_t _base{0};
+    uint16_t _slots{0};
+    uint16_t _head{0};
+    uint32_t _seq{0};
+    bool _empty{true};
+};
@@ -0,0 +1,328 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_kv.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include "crc.h"
+
+/**
+ * @brief named parameters in a serial EEPROM (AT2432 or EepromSim)
+ *
+ * The region starts with an open-addressing hash index, one 16-bit key hash per
+ * value slot (0xffff - empty, 0x0000 - deleted), followed by the value slots:
+ *
+ *   index  | h16[0] | h16[1] | ... | h16[Slots - 1] |   (rounded up to pages)
+ *   slot i | hash32 (4, LE) | len (1) | value (SlotSize - 7) | crc16 (2, LE) |
+ *
+ * A lookup is one burst read of the index and one read of the value slot, the full
+ * 32-bit hash in the slot resolves collisions of the 16-bit index entries.
+ * An update rewrites the value slot (one page write) and, for a new key, the index entry.
+ *
+ * @tparam Storage - device with readBlock / writeBlock and _pageSize
+ * @tparam Slots - number of keys
+ * @tparam SlotSize - size of the value slot including the header and CRC
+ */
+template <class Storage, uint16_t Slots = 64, uint16_t SlotSize = 32>
+class EepromKV
+{
+    static_assert(SlotSize > 7 && SlotSize - 7 < 256, "invalid slot size");
+    static_assert(Storage::_pageSize % SlotSize == 0, "slot must not straddle a page");
+
+public:
+    static constexpr uint16_t _valueSize = SlotSize - 7;
+    static constexpr uint16_t _indexSize = (Slots * 2 + Storage::_pageSize - 1) / Storage::_pageSize * Storage::_pageSize;
+    static constexpr uint16_t _size = _indexSize + Slots * SlotSize;
+    static constexpr uint16_t _empty = 0xffff;
+    static constexpr uint16_t _deleted = 0x0000;
+
+public:
+    /**
+     * @brief Construct a new store over the region
+     *
+     * @param storage EEPROM instance
+     * @param base first address of the region, page aligned, _size bytes long
+     */
+    EepromKV(Storage &storage, uint16_t base) : _storage(storage),
+                                                _base(base)
+    {
+    }
+
+    /**
+     * @brief checks the store on start, index entries without a valid slot (a torn
+     *        write) are dropped, the other keys stay
+     *
+     * @return true - usable, an erased chip is an empty store
+     * @return false - index unreadable, or no used entry leads to a valid slot
+     *         (the region was never formatted) - format() it
+     */
+    bool mount()
+    {
+        uint16_t index[Slots];
+        uint8_t slot[SlotSize];
+        bool torn[Slots];
+        if (!readIndex(index))
+            return false;
+
+        uint16_t used = 0;
+        uint16_t valid = 0;
+        for (uint16_t pos = 0; pos < Slots; pos++)
+        {
+            torn[pos] = false;
+            if (index[pos] == _empty || index[pos] == _deleted)
+                continue;
+
+            used++;
+            if (!_storage.readBlock(slotAddress(pos), slot, SlotSize))
+                return false;
+
+            if (validSlot(slot) && index16(getU32(slot)) == index[pos])
+                valid++;
+            else
+                torn[pos] = true;
+        }
+
+        if (used && !valid)
+            return false;
+
+        uint8_t entry[2] = {0, 0};
+        for (uint16_t pos = 0; pos < Slots; pos++)
+        {
+            if (torn[pos] && !_storage.writeBlock(_base + pos * 2, entry, 2))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief erases the index, all keys are lost
+     *
+     * @return true - success
+     */
+    bool format()
+    {
+        uint8_t index[Slots * 2];
+        memset(index, 0xff, sizeof(index));
+        return _storage.writeBlock(_base, index, sizeof(index));
+    }
+
+    /**
+     * @brief reads the value
+     *
+     * @param key parameter name
+     * @param data [out] buffer
+     * @param len [in] buffer size, [out] length of the value
+     * @return true - found
+     * @return false - not found, corrupted or the buffer is too small
+     */
+    bool get(const char *key, uint8_t *data, uint8_t &len)
+    {
+        uint16_t index[Slots];
+        uint8_t slot[SlotSize];
+        auto h = hash(key);
+
+        if (!readIndex(index) || find(index, h, slot) < 0)
+            return false;
+
+        if (slot[4] > len)
+            return false;
+
+        len = slot[4];
+        memcpy(data, slot + 5, len);
+        return true;
+    }
+
+    /**
+     * @brief writes the value, only the value slot and for a new key its index entry
+     *
+     * @param key parameter name
+     * @param data value
+     * @param len length, at most _valueSize
+     * @return true - success
+     * @return false - too long, store full or write failed
+     */
+    bool set(const char *key, const uint8_t *data, uint8_t len)
+    {
+        if (len > _valueSize)
+            return false;
+
+        uint16_t index[Slots];
+        uint8_t slot[SlotSize];
+        auto h = hash(key);
+
+        if (!readIndex(index))
+            return false;
+
+        auto pos = find(index, h, slot);
+        bool insert = pos < 0;
+        if (insert)
+        {
+            pos = freeSlot(index, h);
+            if (pos < 0)
+                return false;
+        }
+
+        // value first, a new key becomes visible with its index entry
+        memset(slot, 0, sizeof(slot));
+        putU32(slot, h);
+        slot[4] = len;
+        memcpy(slot + 5, data, len);
+        auto crc = Crc::crc16(slot, SlotSize - 2);
+        slot[SlotSize - 2] = crc & 0xff;
+        slot[SlotSize - 1] = crc >> 8;
+        if (!_storage.writeBlock(slotAddress(pos), slot, SlotSize))
+            return false;
+
+        if (insert)
+        {
+            uint8_t entry[2] = {(uint8_t)(index16(h) & 0xff), (uint8_t)(index16(h) >> 8)};
+            return _storage.writeBlock(_base + pos * 2, entry, 2);
+        }
+        return true;
+    }
+
+    /**
+     * @brief removes the key - marks its index entry as deleted
+     *
+     * @param key parameter name
+     * @return true - removed
+     * @return false - not found or write failed
+     */
+    bool remove(const char *key)
+    {
+        uint16_t index[Slots];
+        uint8_t slot[SlotSize];
+
+        if (!readIndex(index))
+            return false;
+
+        auto pos = find(index, hash(key), slot);
+        if (pos < 0)
+            return false;
+
+        uint8_t entry[2] = {0, 0};
+        return _storage.writeBlock(_base + pos * 2, entry, 2);
+    }
+
+    /**
+     * @brief FNV-1a of the parameter name
+     *
+     * @param key parameter name
+     * @return uint32_t
+     */
+    static uint32_t hash(const char *key)
+    {
+        uint32_t h = 2166136261u;
+        while (*key)
+        {
+            h ^= (uint8_t)*key++;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+private:
+    /**
+     * @brief folded hash for the index, never equal to the empty or deleted marks
+     *
+     */
+    static uint16_t index16(uint32_t h)
+    {
+        uint16_t rc = (h >> 16) ^ (h & 0xffff);
+        if (rc == _empty)
+            rc = 0xfffe;
+        if (rc == _deleted)
+            rc = 1;
+        return rc;
+    }
+
+    uint16_t slotAddress(uint16_t pos) const
+    {
+        return _base + _indexSize + pos * SlotSize;
+    }
+
+    static void putU32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v & 0xff;
+        p[1] = (v >> 8) & 0xff;
+        p[2] = (v >> 16) & 0xff;
+        p[3] = v >> 24;
+    }
+
+    static uint32_t getU32(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static bool validSlot(const uint8_t *slot)
+    {
+        uint16_t crc = slot[SlotSize - 2] | (slot[SlotSize - 1] << 8);
+        return slot[4] <= _valueSize && crc == Crc::crc16(slot, SlotSize - 2);
+    }
+
+    bool readIndex(uint16_t *index)
+    {
+        uint8_t raw[Slots * 2];
+        if (!_storage.readBlock(_base, raw, sizeof(raw)))
+            return false;
+
+        for (uint16_t i = 0; i < Slots; i++)
+        {
+            index[i] = raw[2 * i] | (raw[2 * i + 1] << 8);
+        }
+        return true;
+    }
+
+    /**
+     * @brief probes the index and verifies the candidate slots
+     *
+     * @param index index content
+     * @param h key hash
+     * @param slot [out] content of the found slot
+     * @return int16_t - slot number or -1
+     */
+    int16_t find(const uint16_t *index, uint32_t h, uint8_t *slot)
+    {
+        auto h16 = index16(h);
+        auto pos = h16 % Slots;
+        for (uint16_t i = 0; i < Slots; i++, pos = (pos + 1) % Slots)
+        {
+            if (index[pos] == _empty)
+                break;
+
+            if (index[pos] != h16)
+                continue;
+
+            if (!_storage.readBlock(slotAddress(pos), slot, SlotSize))
+                return -1;
+
+            if (getU32(slot) == h && validSlot(slot))
+                return pos;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief the first empty or deleted entry on the probe sequence
+     *
+     */
+    int16_t freeSlot(const uint16_t *index, uint32_t h) const
+    {
+        auto pos = index16(h) % Slots;
+        for (uint16_t i = 0; i < Slots; i++, pos = (pos + 1) % Slots)
+        {
+            if (index[pos] == _empty || index[pos] == _deleted)
+                return pos;
+        }
+        return -1;
+    }
+
+private:
+    Storage &_storage;
+    uint16_t _base{0};
+};
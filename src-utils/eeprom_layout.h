@@ -0,0 +1,195 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_layout.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <type_traits>
+
+/**
+ * @brief geometry of the AT24C32
+ *
+ */
+struct AT24C32Geometry
+{
+    static constexpr uint16_t _pageSize = 32;
+    static constexpr uint16_t _memSize = 4096;
+};
+
+/**
+ * @brief typed EEPROM field at a fixed offset
+ *
+ * The value is stored in its native (little-endian) representation, the access is
+ * one burst transaction of exactly sizeof(T) bytes. The field must not straddle
+ * a page, so a write is always one page write.
+ *
+ * e.g. using Contrast = EepromField<uint8_t, 0x03>;
+ *      Contrast::write(at, 0xa1);
+ *
+ * @tparam T - trivially copyable type
+ * @tparam Offset - address of the field
+ * @tparam Geometry - page and memory size of the chip
+ */
+template <class T, uint16_t Offset, class Geometry = AT24C32Geometry>
+struct EepromField
+{
+    static_assert(std::is_trivially_copyable<T>::value, "field type must be trivially copyable");
+    static_assert(Offset + sizeof(T) <= Geometry::_memSize, "field out of memory");
+    static_assert(Offset / Geometry::_pageSize == (Offset + sizeof(T) - 1) / Geometry::_pageSize,
+                  "field straddles a page boundary");
+
+    using Type = T;
+    static constexpr uint16_t _offset = Offset;
+    static constexpr uint16_t _size = sizeof(T);
+
+    template <class Storage>
+    static bool read(Storage &storage, T &val)
+    {
+        return storage.readBlock(Offset, reinterpret_cast<uint8_t *>(&val), sizeof(T));
+    }
+
+    template <class Storage>
+    static bool write(Storage &storage, const T &val)
+    {
+        return storage.writeBlock(Offset, reinterpret_cast<const uint8_t *>(&val), sizeof(T));
+    }
+};
+
+/**
+ * @brief typed EEPROM array at a fixed offset
+ *
+ * No element straddles a page, the whole array is one burst read.
+ *
+ * @tparam T - trivially copyable element type
+ * @tparam N - number of elements
+ * @tparam Offset - address of the first element
+ * @tparam Geometry - page and memory size of the chip
+ */
+template <class T, uint16_t N, uint16_t Offset, class Geometry = AT24C32Geometry>
+struct EepromArray
+{
+    static_assert(std::is_trivially_copyable<T>::value, "element type must be trivially copyable");
+    static_assert(N > 0, "empty array");
+    static_assert(Offset + N * sizeof(T) <= Geometry::_memSize, "array out of memory");
+
+    static constexpr bool elementsInPages()
+    {
+        for (uint16_t i = 0; i < N; i++)
+        {
+            uint16_t first = Offset + i * sizeof(T);
+            if (first / Geometry::_pageSize != (first + sizeof(T) - 1) / Geometry::_pageSize)
+                return false;
+        }
+        return true;
+    }
+    static_assert(elementsInPages(), "array element straddles a page boundary");
+
+    using Type = T;
+    static constexpr uint16_t _offset = Offset;
+    static constexpr uint16_t _size = N * sizeof(T);
+    static constexpr uint16_t _count = N;
+
+    template <class Storage>
+    static bool read(Storage &storage, T (&vals)[N])
+    {
+        return storage.readBlock(Offset, reinterpret_cast<uint8_t *>(vals), _size);
+    }
+
+    template <class Storage>
+    static bool write(Storage &storage, const T (&vals)[N])
+    {
+        return storage.writeBlock(Offset, reinterpret_cast<const uint8_t *>(vals), _size);
+    }
+
+    template <class Storage>
+    static bool readAt(Storage &storage, uint16_t i, T &val)
+    {
+        return (i < N) && storage.readBlock(Offset + i * sizeof(T), reinterpret_cast<uint8_t *>(&val), sizeof(T));
+    }
+
+    template <class Storage>
+    static bool writeAt(Storage &storage, uint16_t i, const T &val)
+    {
+        return (i < N) && storage.writeBlock(Offset + i * sizeof(T), reinterpret_cast<const uint8_t *>(&val), sizeof(T));
+    }
+};
+
+/**
+ * @brief raw EEPROM region managed by another component (journal, key-value store ...),
+ *        declared in the layout only for the overlap checks
+ *
+ * e.g. using Log = EepromRegion<0x800, 0x800>;
+ *      EepromJournal<AT2432> log(at, Log::_offset, Log::_size);
+ *
+ * @tparam Offset - first address of the region
+ * @tparam Size - length of the region in bytes
+ * @tparam Geometry - page and memory size of the chip
+ */
+template <uint16_t Offset, uint16_t Size, class Geometry = AT24C32Geometry>
+struct EepromRegion
+{
+    static_assert(Size > 0, "empty region");
+    static_assert(Offset + Size <= Geometry::_memSize, "region out of memory");
+
+    static constexpr uint16_t _offset = Offset;
+    static constexpr uint16_t _size = Size;
+};
+
+/**
+ * @brief compile-time checks of all fields of the layout
+ *
+ */
+template <class... Fields>
+constexpr bool eepromDisjoint()
+{
+    constexpr uint16_t offset[] = {Fields::_offset...};
+    constexpr uint16_t size[] = {Fields::_size...};
+    for (uint16_t i = 0; i < sizeof...(Fields); i++)
+    {
+        for (uint16_t j = i + 1; j < sizeof...(Fields); j++)
+        {
+            if (offset[i] < offset[j] + size[j] && offset[j] < offset[i] + size[i])
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief the first address after all fields
+ *
+ */
+template <class... Fields>
+constexpr uint16_t eepromEnd()
+{
+    constexpr uint16_t end[] = {(uint16_t)(Fields::_offset + Fields::_size)...};
+    uint16_t rc = 0;
+    for (auto e : end)
+    {
+        if (e > rc)
+            rc = e;
+    }
+    return rc;
+}
+
+/**
+ * @brief EEPROM layout - the list of fields and regions, none of them may overlap
+ *
+ * The checks run when the layout is instantiated, e.g.
+ *      using Settings = EepromLayout<BootFlag, Contrast, Calibration>;
+ *      static_assert(Settings::_end <= 0x100, "settings area exceeded");
+ *
+ */
+template <class... Fields>
+struct EepromLayout
+{
+    static_assert(sizeof...(Fields) > 0, "empty layout");
+    static_assert(eepromDisjoint<Fields...>(), "EEPROM fields overlap");
+
+    // first free address after the layout
+    static constexpr uint16_t _end = eepromEnd<Fields...>();
+};
@@ -0,0 +1,250 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_queue.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include "at24_block.h"
+
+/**
+ * @brief non-blocking write queue for a serial EEPROM (AT2432 or EepromSim)
+ *
+ * write() copies the data into a bounded ring and returns immediately. poll(),
+ * called from the main loop, checks the ACK readiness of the chip and issues at most
+ * one page write per call, so the caller never waits for the 5 ms write cycle.
+ * The completion callback of a request is called from poll().
+ *
+ * Reads of the chip are not coordinated with the queue - drain it by flush()
+ * before reading data that may still be queued.
+ *
+ * @tparam Device - device with pageWrite / isReady, _pageSize, _memSize and _readyTimeoutUs
+ * @tparam Depth - number of ring entries
+ * @tparam EntrySize - data bytes per entry, longer writes take more entries
+ */
+template <class Device, uint8_t Depth = 8, uint16_t EntrySize = 32>
+class EepromWriteQueue
+{
+    static_assert(Depth > 0, "empty queue");
+
+public:
+    /**
+     * @brief completion callback
+     *
+     * @param ctx user context given to write()
+     * @param ok true - written, false - the chip did not respond
+     */
+    using Callback = void (*)(void *ctx, bool ok);
+
+    /**
+     * @brief microsecond clock for the latency statistics and timeouts
+     *
+     */
+    using Clock = uint64_t (*)();
+
+    /**
+     * @brief queue statistics
+     *
+     */
+    struct Stats
+    {
+        uint32_t _completed;      // finished requests
+        uint32_t _failed;         // requests dropped on timeout or NACK
+        uint32_t _rejected;       // write() calls refused, queue full
+        uint8_t _maxDepth;        // high-water mark of used entries
+        uint64_t _totalLatencyUs; // sum of write() -> completion times
+        uint64_t _maxLatencyUs;   // worst write() -> completion time
+    };
+
+public:
+    /**
+     * @brief Construct a new queue
+     *
+     * @param dev EEPROM instance
+     * @param clock microsecond clock, e.g. time_us_64
+     */
+    EepromWriteQueue(Device &dev, Clock clock) : _dev(dev),
+                                                 _clock(clock)
+    {
+    }
+
+    /**
+     * @brief queues the write and returns immediately
+     *
+     * @param addr memory location address
+     * @param data buffer, copied
+     * @param len length
+     * @param cb completion callback or nullptr
+     * @param ctx user context for the callback
+     * @return true - queued
+     * @return false - not enough free entries
+     */
+    bool write(uint16_t addr, const uint8_t *data, uint16_t len, Callback cb = nullptr, void *ctx = nullptr)
+    {
+        uint16_t need = (len + EntrySize - 1) / EntrySize;
+        if (len == 0 || need > Depth - _count)
+        {
+            _stats._rejected++;
+            return false;
+        }
+
+        auto now = _clock();
+        while (len)
+        {
+            uint16_t n = (len < EntrySize) ? len : EntrySize;
+            auto &e = _ring[(_head + _count) % Depth];
+            e._addr = addr;
+            e._len = n;
+            e._done = 0;
+            e._queuedUs = now;
+            memcpy(e._data, data, n);
+
+            // the callback belongs to the last part of the request
+            len -= n;
+            e._last = (len == 0);
+            e._cb = cb;
+            e._ctx = ctx;
+
+            addr = (addr + n) & (Device::_memSize - 1);
+            data += n;
+            _count++;
+        }
+
+        if (_count > _stats._maxDepth)
+            _stats._maxDepth = _count;
+        return true;
+    }
+
+    /**
+     * @brief drives the queue - one readiness poll and at most one page write
+     *
+     * @return true - work is pending
+     * @return false - the queue is idle
+     */
+    bool poll()
+    {
+        if (_inFlight)
+        {
+            if (!_dev.isReady())
+            {
+                if (_clock() - _issuedUs > Device::_readyTimeoutUs)
+                    complete(false);
+                return true;
+            }
+
+            _inFlight = false;
+            auto &e = _ring[_head];
+            e._done += _chunk;
+            if (e._done == e._len)
+                complete(true);
+        }
+
+        if (_count == 0)
+            return false;
+
+        auto &e = _ring[_head];
+        uint16_t addr = (e._addr + e._done) & (Device::_memSize - 1);
+        _chunk = AT24Block::pageChunk(Device::_pageSize, addr, e._len - e._done);
+        if (!_dev.pageWrite(addr, e._data + e._done, _chunk))
+        {
+            // the chip is still busy from a write outside of the queue, retry later
+            auto now = _clock();
+            if (!_nack)
+            {
+                _nack = true;
+                _issuedUs = now;
+            }
+            else if (now - _issuedUs > Device::_readyTimeoutUs)
+            {
+                complete(false);
+            }
+            return true;
+        }
+
+        _nack = false;
+        _inFlight = true;
+        _issuedUs = _clock();
+        return true;
+    }
+
+    /**
+     * @brief blocking drain of the queue
+     *
+     */
+    void flush()
+    {
+        while (poll())
+        {
+        }
+    }
+
+    uint8_t pending() const { return _count; }
+    bool idle() const { return _count == 0; }
+    const Stats &stats() const { return _stats; }
+    void clearStats() { memset(&_stats, 0, sizeof(_stats)); }
+
+private:
+    struct Entry
+    {
+        uint16_t _addr;
+        uint16_t _len;
+        uint16_t _done; // bytes acknowledged by the chip
+        uint64_t _queuedUs;
+        bool _last; // the last part of the request
+        Callback _cb;
+        void *_ctx;
+        uint8_t _data[EntrySize];
+    };
+
+    /**
+     * @brief finishes the head entry, a failure drops the remaining parts of the request
+     *
+     */
+    void complete(bool ok)
+    {
+        _inFlight = false;
+        _nack = false;
+
+        bool last = false;
+        do
+        {
+            auto &e = _ring[_head];
+            last = e._last;
+            auto cb = e._cb;
+            auto ctx = e._ctx;
+            auto latency = _clock() - e._queuedUs;
+            _head = (_head + 1) % Depth;
+            _count--;
+
+            if (last)
+            {
+                _stats._totalLatencyUs += latency;
+                if (latency > _stats._maxLatencyUs)
+                    _stats._maxLatencyUs = latency;
+                if (ok)
+                    _stats._completed++;
+                else
+                    _stats._failed++;
+
+                if (cb)
+                    cb(ctx, ok);
+            }
+        } while (!ok && !last && _count);
+    }
+
+private:
+    Device &_dev;
+    Clock _clock{nullptr};
+    Entry _ring[Depth];
+    uint8_t _head{0};
+    uint8_t _count{0};
+    bool _inFlight{false};
+    bool _nack{false};
+    uint16_t _chunk{0};
+    uint64_t _issuedUs{0};
+    Stats _stats{};
+};
@@ -0,0 +1,165 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_record.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include "crc.h"
+
+/**
+ * @brief power-loss safe record in a serial EEPROM (AT2432 or EepromSim)
+ *
+ * Two versioned slots (A/B), a save always overwrites the older one, so a torn
+ * write leaves the previous version intact. Loading is two short burst reads.
+ *
+ *   slot | version (4, LE) | data (Size) | crc16 (2, LE) |   (rounded up to pages)
+ *
+ * @tparam Storage - device with readBlock / writeBlock and _pageSize
+ * @tparam Size - size of the record data
+ */
+template <class Storage, uint16_t Size>
+class EepromRecord
+{
+public:
+    static constexpr uint16_t _slotSize = (Size + 6 + Storage::_pageSize - 1) / Storage::_pageSize * Storage::_pageSize;
+    static constexpr uint16_t _size = 2 * _slotSize;
+
+    static_assert(_size <= Storage::_memSize, "record does not fit");
+
+    /**
+     * @brief result of load()
+     *
+     */
+    enum class Status : uint8_t
+    {
+        Ok = 0,  // the newest valid slot was read
+        Empty,   // both slots read, none valid (never written)
+        IoError  // a slot could not be read, the state is unknown
+    };
+
+public:
+    /**
+     * @brief Construct a new record over the region
+     *
+     * @param storage EEPROM instance
+     * @param base first address of the region, page aligned, _size bytes long
+     */
+    EepromRecord(Storage &storage, uint16_t base) : _storage(storage),
+                                                    _base(base)
+    {
+    }
+
+    /**
+     * @brief reads both slots and returns the newest valid one
+     *
+     * After an I/O error the record stays unloaded, a save is refused until
+     * a load succeeds - the unread slot may hold the newer version.
+     *
+     * @param data [out] buffer of Size
+     * @return Status
+     */
+    Status load(uint8_t *data)
+    {
+        uint8_t a[Size + 6];
+        uint8_t b[Size + 6];
+        uint32_t va = 0, vb = 0;
+        bool okA = false, okB = false;
+
+        if (!readSlot(0, a, va, okA) || !readSlot(1, b, vb, okB))
+            return Status::IoError;
+
+        _loaded = true;
+        _valid = okA || okB;
+        if (!_valid)
+        {
+            _active = 1; // the next save goes to slot A
+            _version = 0;
+            return Status::Empty;
+        }
+
+        // newer in the sense of serial numbers, survives the overflow
+        bool useA = okA && (!okB || (int32_t)(va - vb) > 0);
+        _active = useA ? 0 : 1;
+        _version = useA ? va : vb;
+        memcpy(data, (useA ? a : b) + 4, Size);
+        return Status::Ok;
+    }
+
+    /**
+     * @brief writes the data into the older slot with the next version
+     *
+     * @param data buffer of Size
+     * @return true - written, it is the newest version from now
+     * @return false - write failed, the previous version stays valid,
+     *                 or the slots could not be loaded
+     */
+    bool save(const uint8_t *data)
+    {
+        if (!_loaded)
+        {
+            uint8_t tmp[Size];
+            if (load(tmp) == Status::IoError)
+                return false;
+        }
+
+        uint8_t slot[Size + 6];
+        uint32_t version = _version + 1;
+        slot[0] = version & 0xff;
+        slot[1] = (version >> 8) & 0xff;
+        slot[2] = (version >> 16) & 0xff;
+        slot[3] = version >> 24;
+        memcpy(slot + 4, data, Size);
+        auto crc = Crc::crc16(slot, Size + 4);
+        slot[Size + 4] = crc & 0xff;
+        slot[Size + 5] = crc >> 8;
+
+        uint8_t target = _active ^ 1;
+        if (!_storage.writeBlock(_base + target * _slotSize, slot, sizeof(slot)))
+            return false;
+
+        _active = target;
+        _version = version;
+        _valid = true;
+        return true;
+    }
+
+    bool loaded() const { return _loaded; }
+    bool valid() const { return _valid; }
+    uint32_t version() const { return _version; }
+    uint8_t active() const { return _active; }
+
+private:
+    /**
+     * @brief reads the slot and checks its CRC
+     *
+     * @param n slot number
+     * @param slot [out] content
+     * @param version [out] version of the slot
+     * @param ok [out] CRC matches
+     * @return true - read
+     * @return false - I/O error
+     */
+    bool readSlot(uint8_t n, uint8_t *slot, uint32_t &version, bool &ok)
+    {
+        if (!_storage.readBlock(_base + n * _slotSize, slot, Size + 6))
+            return false;
+
+        version = slot[0] | (slot[1] << 8) | (slot[2] << 16) | ((uint32_t)slot[3] << 24);
+        uint16_t crc = slot[Size + 4] | (slot[Size + 5] << 8);
+        ok = crc == Crc::crc16(slot, Size + 4);
+        return true;
+    }
+
+private:
+    Storage &_storage;
+    uint16_t _base{0};
+    uint32_t _version{0};
+    uint8_t _active{1};
+    bool _valid{false};
+    bool _loaded{false};
+};
@@ -0,0 +1,294 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_sim.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include "at24_block.h"
+
+/**
+ * @brief in-memory model of the AT24C32 for host builds
+ *
+ * It has the same block interface as AT2432 and models the page wrap of a single
+ * page write, the internal write cycle (the chip does not acknowledge while busy)
+ * and the time spent on the I2C bus. The time is virtual, nothing sleeps.
+ * A power cut can be injected into a page write to test torn data.
+ */
+class EepromSim
+{
+public:
+    static constexpr uint16_t _pageSize = 32;
+    static constexpr uint16_t _memSize = 4096;
+    static constexpr uint16_t _pages = _memSize / _pageSize;
+    static constexpr uint32_t _writeCycleUs = 5000; // tWR
+    static constexpr uint32_t _byteUs = 90;         // 9 clocks at 100 kHz
+    static constexpr uint32_t _readyTimeoutUs = 20000;
+
+public:
+    /**
+     * @brief Construct a new simulated EEPROM, erased to 0xff
+     *
+     * @param writeCycleUs duration of the internal write cycle
+     * @param byteUs duration of one byte on the bus
+     */
+    explicit EepromSim(uint32_t writeCycleUs = _writeCycleUs,
+                       uint32_t byteUs = _byteUs) : _cycleUs(writeCycleUs),
+                                                    _byteCostUs(byteUs)
+    {
+        memset(_mem, 0xff, sizeof(_mem));
+        memset(_wear, 0, sizeof(_wear));
+    }
+
+    /**
+     * @brief one page write transaction, the data wraps within the page like on the chip
+     *
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length, at most one page
+     * @return true - acknowledged
+     * @return false - busy or invalid length
+     */
+    bool pageWrite(uint16_t addr, const uint8_t *data, uint16_t len)
+    {
+        if (!transaction(3) || len > _pageSize)
+        {
+            return false;
+        }
+
+        busTime(len);
+        addr &= (_memSize - 1);
+        uint16_t base = addr - (addr % _pageSize);
+
+        // power cut during this write cycle - only a part of the page is programmed
+        bool cut = _cutArmed && _cutAfter-- == 0;
+        uint16_t programmed = (cut && _tornBytes < len) ? _tornBytes : len;
+        for (uint16_t i = 0; i < programmed; i++)
+        {
+            _mem[base + ((addr + i) % _pageSize)] = data[i];
+        }
+
+        if (cut)
+        {
+            _cutArmed = false;
+            _off = true;
+            return false;
+        }
+
+        _wear[base / _pageSize]++;
+        _writeCycles++;
+        _busyUntil = _nowUs + _cycleUs;
+        return true;
+    }
+
+    /**
+     * @brief ACK polling - addresses the chip once
+     *
+     * @return true - write cycle finished
+     */
+    bool isReady()
+    {
+        _polls++;
+        return transaction(1);
+    }
+
+    /**
+     * @brief polls until the write cycle is finished
+     *
+     * @return true - ready
+     * @return false - timeout
+     */
+    bool waitReady()
+    {
+        auto start = _nowUs;
+        while (!isReady())
+        {
+            if (_nowUs - start > _readyTimeoutUs)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief writes the block split on page boundaries
+     *
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length
+     * @return true - success
+     */
+    bool writeBlock(uint16_t addr, const uint8_t *data, uint16_t len)
+    {
+        return AT24Block::write(*this, addr, data, len);
+    }
+
+    /**
+     * @brief byte write with ACK polling
+     *
+     * @param addr memory location address
+     * @param data octet value
+     */
+    void writeIO(uint16_t addr, const uint8_t data)
+    {
+        writeBlock(addr, &data, 1);
+    }
+
+    /**
+     * @brief compare-before-write, only changed pages are written
+     *
+     * @param addr memory location address
+     * @param data buffer
+     * @param len length
+     * @param stats [in,out] skipped / written pages and bytes
+     * @return true - success
+     */
+    bool updateBlock(uint16_t addr, const uint8_t *data, uint16_t len, AT24Block::DeltaStats &stats)
+    {
+        return AT24Block::update(*this, addr, data, len, stats);
+    }
+
+    /**
+     * @brief sequential read
+     *
+     */
+    bool readBlock(uint16_t addr, uint8_t *data, uint16_t len)
+    {
+        return seqRead(addr, data, len);
+    }
+
+    /**
+     * @brief sequential read, rolls over at the end of the memory
+     *
+     * @param addr memory location address
+     * @param data [out] buffer
+     * @param len length
+     * @return true - acknowledged
+     * @return false - busy
+     */
+    bool seqRead(uint16_t addr, uint8_t *data, uint16_t len)
+    {
+        // address write + repeated start with the read address
+        if (!transaction(3) || !transaction(1))
+        {
+            return false;
+        }
+
+        busTime(len);
+        for (uint16_t i = 0; i < len; i++)
+        {
+            data[i] = _mem[(addr + i) & (_memSize - 1)];
+        }
+        return true;
+    }
+
+    /**
+     * @brief reads the octet
+     *
+     * @param addr memory location address
+     * @return uint8_t - octet value
+     */
+    uint8_t readIO(uint16_t addr)
+    {
+        uint8_t data = 0;
+        readBlock(addr, &data, 1);
+        return data;
+    }
+
+    /**
+     * @brief lets the virtual time pass, e.g. the work done by the caller
+     *
+     * @param us microseconds
+     */
+    void advance(uint64_t us)
+    {
+        _nowUs += us;
+    }
+
+    /**
+     * @brief arms the power cut
+     *
+     * @param afterWrites number of page writes that complete before the cut
+     * @param tornBytes bytes of the interrupted page write that reach the cells
+     */
+    void cutPower(uint32_t afterWrites, uint16_t tornBytes = 0)
+    {
+        _cutArmed = true;
+        _cutAfter = afterWrites;
+        _tornBytes = tornBytes;
+    }
+
+    /**
+     * @brief power is back, the chip responds again
+     *
+     */
+    void restorePower()
+    {
+        _cutArmed = false;
+        _off = false;
+        _busyUntil = 0;
+    }
+
+    bool powered() const { return !_off; }
+
+    /**
+     * @brief clears the statistics, the content and wear stay
+     *
+     */
+    void resetStats()
+    {
+        _nowUs = _busyUntil = 0;
+        _transactions = _polls = _writeCycles = 0;
+    }
+
+    const uint8_t *memory() const { return _mem; }
+    uint8_t *memory() { return _mem; }
+    uint64_t elapsedUs() const { return _nowUs; }
+    uint32_t transactions() const { return _transactions; }
+    uint32_t polls() const { return _polls; }
+    uint32_t writeCycles() const { return _writeCycles; }
+    uint32_t pageWear(uint16_t page) const { return (page < _pages) ? _wear[page] : 0; }
+
+private:
+    /**
+     * @brief starts the transaction - device address and the given header bytes on the bus
+     *
+     * @param bytes number of bytes until the chip acknowledges
+     * @return true - acknowledged
+     * @return false - NACK, the chip is in the write cycle
+     */
+    bool transaction(uint16_t bytes)
+    {
+        _transactions++;
+        if (_off || _nowUs < _busyUntil)
+        {
+            busTime(1);
+            return false;
+        }
+        busTime(bytes);
+        return true;
+    }
+
+    void busTime(uint32_t bytes)
+    {
+        _nowUs += bytes * _byteCostUs;
+    }
+
+private:
+    uint8_t _mem[_memSize];
+    uint32_t _wear[_pages];
+    uint32_t _cycleUs{_writeCycleUs};
+    uint32_t _byteCostUs{_byteUs};
+    uint64_t _nowUs{0};
+    uint64_t _busyUntil{0};
+    uint32_t _transactions{0};
+    uint32_t _polls{0};
+    uint32_t _writeCycles{0};
+    bool _off{false};
+    bool _cutArmed{false};
+    uint32_t _cutAfter{0};
+    uint16_t _tornBytes{0};
+};
@@ -13,6 +13,7 @@
 #include <memory>
 
 #include "hardware/uart.h"
+#include "hardware/sync.h"
 #include "gps.h"
 #include "at2432.h"
 #include "ds3231.h"
@@ -21,6 +22,16 @@
 #include "time_base.h"
 #include "time_utils.h"
 #include "debug_utils.h"
+#include "eeprom_journal.h"
+#include "eeprom_kv.h"
+#include "eeprom_layout.h"
+#include "sqw_clock.h"
+#include "aging_calibrator.h"
+#include "window_stats.h"
+#include "drift_estimator.h"
+#include "edge_counter.h"
+#include "clock_manager.h"
+#include "rtc_scheduler.h"
 
 #define UART_ID uart0
 #define UART_ID2 uart1
@@ -32,6 +43,10 @@
 #define UART_RX_PIN2 5
 
 GPS gps;
+TimeBase g_tmb;
+volatile uint64_t g_sentenceUs = 0; // start of the last NMEA sentence
+volatile uint32_t g_fixSeconds = 0;  // last GPS time (unixtime)
+volatile uint64_t g_fixUs = 0;       // and its local stamp, 0 - no fix
 void on_uart_rx();
 
 void uart()
@@ -49,6 +64,10 @@ void uart()
 
     uart_set_fifo_enabled(UART_ID2, false);
 
+    // GPS fixes slew the microsecond clock, only large offsets step it
+    g_tmb.init();
+    g_tmb.setSlew(true);
+
     irq_set_exclusive_handler(UART1_IRQ, on_uart_rx);
     irq_set_enabled(UART1_IRQ, true);
 
@@ -61,6 +80,9 @@ void on_uart_rx()
     while (uart_is_readable(UART_ID2))
     {
         uint8_t ch = uart_getc(UART_ID2);
+        // the fix belongs to the stamp of its own sentence
+        if (ch == '$')
+            g_sentenceUs = time_us_64();
         // Can we send it back?
         gps.parse(ch);
         if (gps.isValidTime())
@@ -70,18 +92,26 @@ void on_uart_rx()
                 .year = gps.year(),
                 .month = gps.month(),
                 .day = gps.day(),
-                .dotw = gps.weekDay(), // 0 is Sunday, so 5 is Friday
+                .dotw = 0, // from the validated date below
                 .hour = gps.hour(),
                 .min = gps.minute(),
                 .sec = gps.second()};
-
-            rtc_set_datetime(&t);
             /*
                if (uart_is_writable(UART_ID2)) {
                        printf("%d.%d.%d\n", gps.hour(),gps.minute(),gps.second());
                }
                */
             gps.resetValidTime();
+
+            // an RMC without the time (no fix yet) is skipped, a second is applied once
+            auto seconds = TimeUtils::makeUnixTime(t);
+            if (TimeUtils::isValid(t) && seconds != g_fixSeconds)
+            {
+                TimeUtils::updateDayOfWeek(t); // 0 is Sunday, so 5 is Friday
+                g_tmb.updateTime(t, g_sentenceUs);
+                g_fixSeconds = seconds;
+                g_fixUs = g_sentenceUs;
+            }
         }
     }
 }
@@ -202,6 +232,17 @@ void pcftest2()
 
 // ---------------------------------------------------------------------------------------
 
+// EEPROM map of the demos, an overlap fails the build
+using DemoKV = EepromKV<AT2432, 32>;
+using BootFlag = EepromField<uint8_t, 0x00>;
+using Contrast = EepromField<uint8_t, 0x03>;
+using Mode = EepromField<uint8_t, 0x06>;
+using BlockTest = EepromRegion<0x1c, 8>;
+using KVArea = EepromRegion<0x040, DemoKV::_size>;
+using LogArea = EepromRegion<0x800, 0x800>;
+using DemoLayout = EepromLayout<BootFlag, Contrast, Mode, BlockTest, KVArea, LogArea>;
+static_assert(DemoLayout::_end <= AT2432::_memSize, "demo layout out of memory");
+
 void at2432test()
 {
     AT2432 at(i2c1, 2, 3, 0x57);
@@ -218,11 +259,71 @@ void at2432test()
     }
 
     at.clearCheckSum();
-    at.writeIO(0x00, 0x01);
-    at.writeIO(0x03, 0xa1);
-    at.writeIO(0x06, 0x1a);
-    DebugUtils::memdump(at, 0, 16);
-    printf("checksum: %02x\n", at.checkSum());
+    BootFlag::write(at, 0x01);
+    Contrast::write(at, 0xa1);
+    Mode::write(at, 0x1a);
+
+    // crosses the page boundary 0x20 - two page writes
+    const uint8_t block[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    static_assert(sizeof(block) == BlockTest::_size, "block test size");
+    at.writeBlock(BlockTest::_offset, block, sizeof(block));
+    DebugUtils::memdump(at, 0, 48);
+    printf("checksum: %04x\n", at.checkSum());
+
+    // whole image in one sequential read
+    static uint8_t image[AT2432::_memSize];
+    at.clearCheckSum();
+    at.readBlock(0, image, sizeof(image));
+    auto crc = at.checkSum();
+    printf("image checksum: %04x %s\n", crc, at.verifyRange(0, sizeof(image), crc) ? "OK" : "FAILED");
+}
+
+// ---------------------------------------------------------------------------------------
+
+void journaltest()
+{
+    AT2432 at(i2c1, 2, 3, 0x57);
+    at.init(true);
+
+    // upper half of the chip as an event log
+    EepromJournal<AT2432> log(at, LogArea::_offset, LogArea::_size);
+    if (log.mount())
+    {
+        printf("journal head: %d seq: %lu\n", log.head(), (unsigned long)log.sequence());
+    }
+    else
+    {
+        printf("journal empty\n");
+    }
+
+    uint8_t event[EepromJournal<AT2432>::_payloadSize] = {0x01, 0x02};
+    log.append(event, 2);
+    printf("journal records: %lu\n", (unsigned long)log.count());
+}
+
+// ---------------------------------------------------------------------------------------
+
+void kvtest()
+{
+    AT2432 at(i2c1, 2, 3, 0x57);
+    at.init(true);
+
+    // formatted only when the index is unreadable or corrupt, the other keys stay
+    DemoKV kv(at, KVArea::_offset);
+    if (!kv.mount())
+    {
+        printf("kv: formatted\n");
+        kv.format();
+    }
+
+    uint8_t val[DemoKV::_valueSize];
+    uint8_t len = sizeof(val);
+    if (!kv.get("boot.count", val, len))
+        val[0] = 0;
+
+    val[0]++;
+    kv.set("boot.count", val, 1);
+    printf("boot.count: %d\n", val[0]);
 }
 
 // ---------------------------------------------------------------------------------------
@@ -275,14 +376,294 @@ void ds3231test()
         printf("DS: OFF\n");
     }
 
+    // one burst read per tick, the accessors work on the shadow copy
+    ds.setCached(true);
+    WindowStats<int16_t, 60> temps; // last minute, quarter-degrees
+    while (true)
+    {
+        ds.refresh();
+        auto dt = ds.timeDate();
+        printf("%d:%d:%d  %d.%d.%d  weekD=%d\n", dt.hour, dt.min, dt.sec, dt.day, dt.month, dt.year, dt.dotw);
+
+        int16_t q = 0;
+        if (ds.temperatureQ(q, dt.sec % 10 == 0))
+            temps.add(q);
+        printf("temp  -------> %f  min %f  max %f  mean %f\n", q * 0.25f,
+               temps.min() * 0.25f, temps.max() * 0.25f, temps.mean() * 0.25f);
+        sleep_ms(1000);
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+void onAlarm(void *ctx, DS3231Alarm::Alarm alarm)
+{
+    auto ds = static_cast<DS3231 *>(ctx);
+    auto dt = ds->timeDate();
+    printf("alarm %d: %02d:%02d:%02d\n", (int)alarm, dt.hour, dt.min, dt.sec);
+}
+
+void alarmtest()
+{
+    DS3231 ds(i2c1, 2, 3, 0x68);
+    ds.init(true);
+
+    // tick every second and every minute at :00, no polling
+    ds.setAlarm(DS3231Alarm::Alarm::A1, {DS3231Alarm::Mode::EverySecond, 0, 0, 0, 0});
+    ds.setAlarm(DS3231Alarm::Alarm::A2, {DS3231Alarm::Mode::EveryMinute, 0, 0, 0, 0});
+    ds.clearAlarm(DS3231Alarm::Alarm::A1);
+    ds.clearAlarm(DS3231Alarm::Alarm::A2);
+    ds.enableAlarm(DS3231Alarm::Alarm::A1, true);
+    ds.enableAlarm(DS3231Alarm::Alarm::A2, true);
+    ds.attachInterrupt(14, onAlarm, &ds);
+
+    while (true)
+    {
+        __wfi();
+        ds.service();
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+SqwClock g_sqw;
+
+void sqwIRQHandler(uint gpio, uint32_t events)
+{
+    g_sqw.onEdge(time_us_64());
+}
+
+/**
+ * @brief DS3231 1 Hz output -> GPIO 14, edges bound to the RTC seconds
+ *
+ */
+void sqwinit(DS3231 &ds)
+{
+    ds.setSquareWave(DS3231::SquareWave::Hz1);
+
+    g_sqw.reset();
+    gpio_init(14);
+    gpio_set_dir(14, GPIO_IN);
+    gpio_pull_up(14);
+    gpio_set_irq_enabled_with_callback(14, GPIO_IRQ_EDGE_FALL, true, &sqwIRQHandler);
+
+    // bind the edges to the RTC seconds
+    while (!g_sqw.anchored())
+    {
+        auto edges = g_sqw.edges();
+        auto dt = ds.timeDate();
+        g_sqw.anchor(TimeUtils::makeUnixTime(dt), edges);
+        sleep_ms(100);
+    }
+}
+
+void sqwtest()
+{
+    DS3231 ds(i2c1, 2, 3, 0x68);
+    ds.init(true);
+    sqwinit(ds);
+
+    while (true)
+    {
+        auto us = g_sqw.now(time_us_64());
+        printf("%lu.%06lu  drift %ld ppm\n", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000), (long)g_sqw.driftPpm());
+        sleep_ms(333);
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+/**
+ * @brief one calibration step at a validated GPS fix, the learned value is persisted
+ *
+ */
+void agingsample(DS3231 &ds, AgingCalibrator &cal, DemoKV &kv, uint32_t gpsSeconds, uint64_t gpsUs)
+{
+    // RTC with the sub-second resolution of the square wave, at the stamp of the fix;
+    // the constant NMEA latency does not change the slope
+    auto rtcUs = g_sqw.now(gpsUs);
+    cal.addSample(gpsSeconds, (int64_t)rtcUs - (int64_t)gpsSeconds * 1000000);
+
+    int8_t aging;
+    if (cal.update(aging))
+    {
+        ds.setAgingOffset(aging);
+        uint8_t val = (uint8_t)aging;
+        kv.set("rtc.aging", &val, 1);
+        printf("aging offset: %d\n", aging);
+    }
+}
+
+void agingrestore(DS3231 &ds, AgingCalibrator &cal, DemoKV &kv)
+{
+    uint8_t val = 0;
+    uint8_t len = 1;
+    if (kv.get("rtc.aging", &val, len))
+    {
+        cal.setAging((int8_t)val);
+        ds.setAgingOffset((int8_t)val);
+    }
+}
+
+void agingtest()
+{
+    DS3231 ds(i2c1, 2, 3, 0x68);
+    ds.init(true);
+    AT2432 at(i2c1, 2, 3, 0x57);
+    at.init(false);
+    DemoKV kv(at, KVArea::_offset);
+    if (!kv.mount())
+    {
+        printf("kv: formatted\n");
+        kv.format();
+    }
+
+    AgingCalibrator cal;
+    agingrestore(ds, cal, kv);
+    printf("aging offset: %d\n", cal.aging());
+
+    sqwinit(ds);
+    uart();
+
+    uint64_t lastFixUs = 0;
+    while (true)
+    {
+        auto irq = save_and_disable_interrupts();
+        uint64_t fixUs = g_fixUs;
+        uint32_t fixSeconds = g_fixSeconds;
+        restore_interrupts(irq);
+
+        if (fixUs && fixUs != lastFixUs)
+        {
+            agingsample(ds, cal, kv, fixSeconds, fixUs);
+            lastFixUs = fixUs;
+        }
+        sleep_ms(100);
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+void drifttest()
+{
+    DS3231 ds(i2c1, 2, 3, 0x68);
+    ds.init(true);
+    ds.enable32kHz(true);
+
+    // DS3231 32K output -> GPIO 13 (pwm slice 6, channel B)
+    EdgeCounter counter(13);
+    if (!counter.init())
+    {
+        printf("drift: GPIO is not a pwm B input\n");
+        return;
+    }
+
+    DriftEstimator drift;
     while (true)
     {
-        printf("%d:%d:%d  %d.%d.%d  weekD=%d\n", ds.hour(), ds.minute(), ds.second(), ds.day(), ds.month(), ds.year(), ds.weekDay());
-        printf("temp  -------> %f\n", ds.temperature());
+        uint32_t counts;
+        uint64_t elapsedUs;
+        counter.measure(10000000, counts, elapsedUs);
+        bool ok = drift.addWindow(counts, elapsedUs);
+        printf("drift: %u edges / %llu us -> %s, estimate %.3f ppm\n", (unsigned)counts, (unsigned long long)elapsedUs,
+               ok ? "ok" : "rejected", drift.driftPpm());
+
+        // one true second of sleep
+        if (drift.ready())
+            sleep_us(drift.toLocal(1000000));
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+void clocktest()
+{
+    static const char *names[] = {"GPS", "DS3231", "TimeBase", "none"};
+
+    DS3231 ds(i2c1, 2, 3, 0x68);
+    ds.init(true);
+    uart();
+
+    ClockManager clocks;
+    auto source = ClockManager::Source::None;
+    uint64_t lastFixUs = 0;
+    while (true)
+    {
+        // NMEA time stamped at the start of the sentence, both from the same fix
+        auto irq = save_and_disable_interrupts();
+        uint64_t fixUs = g_fixUs;
+        uint32_t fixSeconds = g_fixSeconds;
+        restore_interrupts(irq);
+
+        // after the fix, so no reading is stamped later than now
+        auto now = time_us_64();
+        if (fixUs && fixUs != lastFixUs)
+        {
+            clocks.report(ClockManager::Source::Gps, (int64_t)fixSeconds * 1000000, fixUs, 2000, now);
+            lastFixUs = fixUs;
+        }
+
+        // DS3231 whole seconds, TCXO about 2 ppm since it was last set
+        if (ds.isOSF())
+        {
+            auto secs = TimeUtils::makeUnixTime(ds.timeDate());
+            clocks.report(ClockManager::Source::Rtc, (int64_t)secs * 1000000 + 500000, now, 500000, now);
+        }
+        else
+        {
+            clocks.invalidate(ClockManager::Source::Rtc, now);
+        }
+
+        // internal clock, slewed to GPS, the local crystal drifts about 20 ppm since the last fix
+        if (g_tmb.nowUs())
+        {
+            uint32_t drift = lastFixUs ? (uint32_t)((now - lastFixUs) * 20 / 1000000) : 1000000;
+            clocks.report(ClockManager::Source::Internal, g_tmb.nowUs(), now, 2000 + drift, now);
+        }
+
+        clocks.update(now);
+        if (clocks.source() != source)
+        {
+            source = clocks.source();
+            printf("clock source: %s\n", names[(uint8_t)source]);
+        }
+
+        printf("time %lld us +- %lld us\n", (long long)clocks.now(time_us_64()), (long long)clocks.errorUs(now));
         sleep_ms(1000);
     }
 }
 
+// ---------------------------------------------------------------------------------------
+
+void onSchedule(void *ctx, uint32_t timer)
+{
+    auto tmb = static_cast<TimeBase *>(ctx);
+    auto dt = tmb->getTimeDate();
+    printf("timer %08x: %02d:%02d:%02d\n", (unsigned)timer, dt.hour, dt.min, dt.sec);
+}
+
+void schedtest()
+{
+    TimeBase tmb;
+    tmb.init();
+    tmb.edit().year(2023).month(1).day(16).hour(15).minute(59).second(50).commit();
+
+    RtcScheduler<> sched(tmb);
+    sched.init();
+
+    // every 10 s and once at 16:00:30, the CPU sleeps in between
+    sched.every(10, onSchedule, &tmb);
+    sched.at(TimeUtils::makeUnixTime(2023, 1, 16, 16, 0, 30), onSchedule, &tmb);
+
+    while (true)
+    {
+        __wfi();
+        sched.service();
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
 void timeutiltest()
 {
 
@@ -362,6 +743,14 @@ void timebasetest()
     // timebase print UTC
     auto val2 = tmb.getTimeDate();
     DebugUtils::printDatetime(val2);
+
+    // time editor: several fields, one RTC write, weekday recomputed
+    if (!tmb.edit().hour(16).minute(30).second(0).commit())
+        printf("timebase edit: invalid time\n");
+
+    // field getters from one snapshot, at most one RTC read per 100 ms
+    tmb.setCached(true);
+    printf("%02d:%02d:%02d\n", tmb.hour(), tmb.minute(), tmb.second());
 }
 
 // ---------------------------------------------------------------------------------------
@@ -384,6 +773,7 @@ int main()
 
     // DebugUtils::i2cscan(i2c1);
     // ds3231test();
+    // agingtest();
 
     printf("STOP   ------->\n");
 
@@ -0,0 +1,193 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   rtc_scheduler.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+#include "hardware/rtc.h"
+#include "time_base.h"
+#include "time_utils.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief wall-clock callbacks on the TimeBase, the RTC alarm wakes the CPU
+ *
+ * The timers are kept in a TimerWheel, only the nearest wake-up is armed
+ * in the RP2040 RTC alarm. The alarm IRQ just sets a flag, the callbacks run
+ * from service() in the main loop, which can sleep in __wfi() in between.
+ * A write of the RTC (a step of the time) makes service() run, the timers
+ * passed by a forward step fire, a backward step just re-arms the alarm.
+ * One instance at a time, the RTC has a single alarm.
+ *
+ * @tparam Capacity - max. number of timers
+ */
+template <uint16_t Capacity = 32>
+class RtcScheduler
+{
+public:
+    using Wheel = TimerWheel<Capacity>;
+    using Handle = typename Wheel::Handle;
+    using Callback = typename Wheel::Callback;
+
+public:
+    /**
+     * @brief Construct a new scheduler
+     *
+     * @param tb initialized time base
+     */
+    explicit RtcScheduler(TimeBase &tb) : _tb(tb)
+    {
+    }
+
+    /**
+     * @brief takes over the RTC alarm
+     *
+     */
+    void init()
+    {
+        _irqInstance = this;
+        _tb.setWriteHook(&RtcScheduler::timeChanged, this);
+        uint32_t now;
+        if (nowS(now))
+            _wheel.advance(now);
+        arm();
+    }
+
+    /**
+     * @brief one-shot callback
+     *
+     * @param when unixtime
+     * @param cb callback
+     * @param ctx user context
+     * @return Handle - Wheel::_invalid when full
+     */
+    Handle at(uint32_t when, Callback cb, void *ctx)
+    {
+        auto h = _wheel.add(when, 0, cb, ctx);
+        arm();
+        return h;
+    }
+
+    /**
+     * @brief periodic callback
+     *
+     * @param period seconds
+     * @param cb callback
+     * @param ctx user context
+     * @param first unixtime of the first run, 0 - one period from now
+     * @return Handle - Wheel::_invalid when full or when first is 0 and the RTC has no valid time
+     */
+    Handle every(uint32_t period, Callback cb, void *ctx, uint32_t first = 0)
+    {
+        uint32_t now = 0;
+        if (!first && !nowS(now))
+            return Wheel::_invalid;
+        auto h = _wheel.add(first ? first : now + period, period, cb, ctx);
+        arm();
+        return h;
+    }
+
+    bool cancel(Handle h)
+    {
+        auto rc = _wheel.cancel(h);
+        arm();
+        return rc;
+    }
+
+    /**
+     * @brief the alarm fired, service() has work
+     *
+     */
+    bool pending() const
+    {
+        return _pending;
+    }
+
+    /**
+     * @brief runs the due callbacks and arms the next alarm, call from the main loop
+     *
+     */
+    void service()
+    {
+        if (!_pending)
+            return;
+
+        _pending = false;
+        uint32_t now;
+        if (!nowS(now))
+        {
+            // no time to compare with, the write of a valid time calls service() again
+            rtc_disable_alarm();
+            return;
+        }
+        _wheel.advance(now);
+        arm();
+    }
+
+    uint16_t active() const { return _wheel.active(); }
+
+private:
+    /**
+     * @brief current unixtime from the RTC
+     *
+     * @param now [out] seconds
+     * @return true - the RTC holds a valid time past the epoch
+     */
+    bool nowS(uint32_t &now)
+    {
+        TimeBase::Snapshot s;
+        if (!_tb.snapshot(s))
+            return false;
+        now = TimeUtils::makeUnixTime(s._dt);
+        return now != 0;
+    }
+
+    /**
+     * @brief RTC alarm for the nearest wake-up
+     *
+     */
+    void arm()
+    {
+        uint32_t when, now;
+        if (!_wheel.nextWakeup(when) || !nowS(now))
+        {
+            rtc_disable_alarm();
+            return;
+        }
+
+        if ((int32_t)(when - now) > 0)
+        {
+            datetime_t t;
+            TimeUtils::breakUnixTime(when, t);
+            t.dotw = -1; // not compared
+            rtc_set_alarm(&t, &RtcScheduler::alarmIrq);
+
+            // an alarm time passed meanwhile never matches
+            if (!nowS(now) || (int32_t)(when - now) > 0)
+                return;
+        }
+        _pending = true;
+    }
+
+    static void timeChanged(void *ctx)
+    {
+        static_cast<RtcScheduler *>(ctx)->_pending = true;
+    }
+
+    static void alarmIrq()
+    {
+        if (_irqInstance)
+            _irqInstance->_pending = true;
+    }
+
+private:
+    TimeBase &_tb;
+    Wheel _wheel;
+    volatile bool _pending{false};
+
+    static inline RtcScheduler *_irqInstance{nullptr};
+};
@@ -0,0 +1,211 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   sqw_clock.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief sub-second time from the 1 Hz square wave of the RTC
+ *
+ * onEdge() is called from the GPIO IRQ with the local timer stamp of every edge,
+ * anchor() binds the edges to the RTC seconds. now() returns the RTC seconds plus
+ * the time since the last edge, scaled by the measured edge-to-edge period,
+ * so the drift of the local crystal against the RTC is corrected.
+ *
+ * The state shared with the IRQ is guarded by a sequence counter, the reader
+ * retries when an edge arrives during the read. The IRQ owns the second count,
+ * anchor() writes only the offset of the count to the RTC seconds, so an edge
+ * arriving meanwhile does not shift it. No platform dependencies.
+ */
+class SqwClock
+{
+public:
+    static constexpr uint32_t _nominalUs = 1000000;
+    static constexpr uint32_t _toleranceUs = 2000; // edge jitter / drift accepted per period
+    static constexpr uint8_t _filterShift = 3;     // period filter, 1/8 of the error per edge
+
+public:
+    /**
+     * @brief forgets the edges and the anchor
+     *
+     */
+    void reset()
+    {
+        _seq++;
+        _edges = 0;
+        _lastEdgeUs = 0;
+        _count = 0;
+        _offset = 0;
+        _anchored = false;
+        _periodQ8 = _nominalUs << 8;
+        _scale = scaleFor(_periodQ8);
+        _seq++;
+    }
+
+    /**
+     * @brief edge of the square wave, called from IRQ
+     *
+     * @param timerUs local timer at the edge, e.g. time_us_64()
+     */
+    void onEdge(uint64_t timerUs)
+    {
+        _seq++;
+        if (_edges)
+        {
+            uint64_t delta = timerUs - _lastEdgeUs;
+            uint32_t period = _periodQ8 >> 8;
+
+            // missed edges count as whole seconds
+            uint32_t n = (delta + period / 2) / period;
+            if (n == 0)
+            {
+                // glitch, ignore the edge
+                _seq++;
+                return;
+            }
+
+            int64_t error = (int64_t)delta - (int64_t)n * period;
+            if (n == 1 && error > -(int64_t)_toleranceUs && error < (int64_t)_toleranceUs)
+            {
+                // filtered in 1/256 us
+                int64_t errQ8 = ((int64_t)delta << 8) - _periodQ8;
+                _periodQ8 += errQ8 >> _filterShift;
+                _scale = scaleFor(_periodQ8);
+            }
+            _count += n;
+        }
+
+        _lastEdgeUs = timerUs;
+        _edges++;
+        _seq++;
+    }
+
+    /**
+     * @brief binds the last edge to the RTC time, read after the edge within the same second
+     *
+     * @param seconds RTC seconds (e.g. unixtime) that started with the last edge
+     * @param edges edges() read before the RTC access, the anchor is refused when an edge came in between
+     * @return true - anchored
+     * @return false - an edge arrived during the RTC read, try again
+     */
+    bool anchor(uint32_t seconds, uint32_t edges)
+    {
+        uint32_t seq, count, last;
+        do
+        {
+            seq = _seq;
+            last = _edges;
+            count = _count;
+        } while ((seq & 1) || seq != _seq);
+
+        if (edges != last || last == 0)
+            return false;
+
+        // single word stores, the IRQ does not write them
+        _offset = seconds - count;
+        _anchored = true;
+        return true;
+    }
+
+    /**
+     * @brief current time in microseconds, seconds of the RTC + interpolated fraction
+     *
+     * @param timerUs local timer now, e.g. time_us_64(), or an earlier stamp
+     * @return uint64_t - microseconds, 0 if not anchored
+     */
+    uint64_t now(uint64_t timerUs) const
+    {
+        uint32_t seq;
+        uint64_t edge, scale;
+        uint32_t count;
+        do
+        {
+            seq = _seq;
+            edge = _lastEdgeUs;
+            count = _count;
+            scale = _scale;
+        } while ((seq & 1) || seq != _seq);
+
+        if (!_anchored)
+            return 0;
+        uint64_t secs = (uint32_t)(count + _offset);
+
+        // a stamp taken before the last edge (e.g. by an IRQ) lies in the previous second,
+        // rounded up so it never reads as the edge itself
+        if (timerUs < edge)
+        {
+            uint64_t back = scaleUp(edge - timerUs, scale);
+            return (back < secs * _nominalUs) ? secs * _nominalUs - back : 0;
+        }
+
+        // local microseconds -> RTC microseconds, at most one second after the edge,
+        // the age is clamped before the Q32 product
+        uint64_t age = timerUs - edge;
+        if (age > 2 * _nominalUs)
+            age = 2 * _nominalUs;
+        uint64_t frac = (age * scale) >> 32;
+        if (frac >= _nominalUs)
+            frac = _nominalUs - 1;
+
+        return secs * _nominalUs + frac;
+    }
+
+    /**
+     * @brief measured period of the square wave in the local timer
+     *
+     * @return uint32_t - microseconds
+     */
+    uint32_t periodUs() const
+    {
+        return _periodQ8 >> 8;
+    }
+
+    /**
+     * @brief drift of the local timer against the RTC
+     *
+     * @return int32_t - ppm, positive - local timer runs fast
+     */
+    int32_t driftPpm() const
+    {
+        return (int32_t)(((int64_t)_periodQ8 - ((int64_t)_nominalUs << 8)) / 256);
+    }
+
+    uint32_t edges() const { return _edges; }
+    bool anchored() const { return _anchored; }
+
+private:
+    /**
+     * @brief Q32 factor converting local microseconds to RTC microseconds
+     *
+     */
+    static uint64_t scaleFor(uint64_t periodQ8)
+    {
+        return ((uint64_t)_nominalUs << 40) / periodQ8;
+    }
+
+    /**
+     * @brief local microseconds -> RTC microseconds rounded up, any age without overflow
+     *
+     */
+    static uint64_t scaleUp(uint64_t us, uint64_t scale)
+    {
+        uint64_t hi = us >> 31;
+        uint64_t lo = us & 0x7fffffff;
+        return ((hi * scale + 1) >> 1) + ((lo * scale + 0xffffffff) >> 32);
+    }
+
+private:
+    volatile uint32_t _seq{0};
+    volatile uint32_t _edges{0};
+    volatile uint64_t _lastEdgeUs{0};
+    volatile uint32_t _count{0};  // seconds since the first edge, written by the IRQ
+    volatile uint32_t _offset{0}; // RTC seconds of count 0, written by anchor()
+    volatile uint64_t _periodQ8{(uint64_t)_nominalUs << 8};
+    volatile uint64_t _scale{1ull << 32};
+    volatile bool _anchored{false};
+};
@@ -0,0 +1,109 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   aging_calibrator_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <random>
+#include "aging_calibrator.h"
+
+static constexpr uint32_t _start = 1673884800; // 2023-01-16 16:00:00
+
+/**
+ * @brief a fix every minute for the given time, the RTC drifts by ppm, the offset jitters
+ *
+ */
+static void feed(AgingCalibrator &cal, double ppm, uint32_t seconds, int noiseUs, uint32_t seed, uint32_t from = _start)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(-noiseUs, noiseUs);
+    for (uint32_t t = 0; t <= seconds; t += 60)
+        cal.addSample(from + t, 250000 + (int64_t)(ppm * t) + noise(rng));
+}
+
+TEST_CASE("least-squares slope of noisy offsets", "[aging]")
+{
+    for (double ppm : {-3.2, -0.45, 0.0, 0.8, 5.0})
+    {
+        AgingCalibrator cal;
+        feed(cal, ppm, 7 * 3600, 500, 16);
+        INFO("ppm " << ppm);
+        CHECK(cal.ready());
+        CHECK(cal.driftPpm() == Approx(ppm).margin(0.02));
+    }
+}
+
+TEST_CASE("no estimate before the window and the samples are complete", "[aging]")
+{
+    AgingCalibrator cal;
+    int8_t aging = 0;
+    feed(cal, 5.0, 6 * 3600 - 60, 0, 1);
+    CHECK_FALSE(cal.ready());
+    CHECK_FALSE(cal.update(aging));
+
+    // a long window of too few samples
+    AgingCalibrator sparse;
+    for (uint32_t i = 0; i < 10; i++)
+        sparse.addSample(_start + i * 3600, i * 100);
+    CHECK_FALSE(sparse.ready());
+}
+
+TEST_CASE("the aging register moves in bounded steps", "[aging]")
+{
+    AgingCalibrator cal(0, 10);
+    int8_t aging = 0;
+
+    // 2.5 ppm fast wants 25 LSB, one update gives 10
+    feed(cal, 2.5, 7 * 3600, 200, 2);
+    REQUIRE(cal.update(aging));
+    CHECK(aging == 10);
+    CHECK(cal.samples() == 0);
+
+    // the remaining 1.5 ppm, the window starts again
+    feed(cal, 1.5, 7 * 3600, 200, 3, _start + 8 * 3600);
+    REQUIRE(cal.update(aging));
+    CHECK(aging == 20);
+
+    // slow RTC - down
+    feed(cal, -0.75, 7 * 3600, 200, 4, _start + 16 * 3600);
+    REQUIRE(cal.update(aging));
+    CHECK(aging == 13);
+    CHECK(cal.aging() == 13);
+}
+
+TEST_CASE("drift within one LSB leaves the register alone", "[aging]")
+{
+    AgingCalibrator cal(-4);
+    int8_t aging = 99;
+
+    // truncated, no hunting around the optimum
+    feed(cal, 0.09, 7 * 3600, 100, 5);
+    CHECK_FALSE(cal.update(aging));
+    CHECK(aging == 99);
+    CHECK(cal.aging() == -4);
+    CHECK(cal.samples() == 0);
+
+    feed(cal, -0.09, 7 * 3600, 100, 6, _start + 8 * 3600);
+    CHECK_FALSE(cal.update(aging));
+    CHECK(cal.aging() == -4);
+}
+
+TEST_CASE("the register saturates at its range", "[aging]")
+{
+    int8_t aging = 0;
+    AgingCalibrator high(125);
+    feed(high, 5.0, 7 * 3600, 0, 7);
+    REQUIRE(high.update(aging));
+    CHECK(aging == 127);
+
+    AgingCalibrator low(-125);
+    feed(low, -5.0, 7 * 3600, 0, 8);
+    REQUIRE(low.update(aging));
+    CHECK(aging == -128);
+
+    // already at the end
+    feed(low, -5.0, 7 * 3600, 0, 9, _start + 8 * 3600);
+    CHECK_FALSE(low.update(aging));
+}
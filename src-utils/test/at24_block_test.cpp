@@ -0,0 +1,210 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   at24_block_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <vector>
+#include "eeprom_sim.h"
+
+static std::vector<uint8_t> pattern(uint16_t len, uint8_t seed)
+{
+    std::vector<uint8_t> buf(len);
+    for (uint16_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 7 + seed);
+    return buf;
+}
+
+TEST_CASE("block write splits on page boundaries", "[at24]")
+{
+    // first and last chunk partial - 12 + 32 + 32 + 24
+    CHECK(AT24Block::pageChunk(32, 20, 100) == 12);
+    CHECK(AT24Block::pageChunk(32, 32, 100) == 32);
+    CHECK(AT24Block::pageChunk(32, 40, 5) == 5);
+
+    EepromSim sim;
+    auto buf = pattern(100, 1);
+    REQUIRE(sim.writeBlock(20, buf.data(), buf.size()));
+    CHECK(sim.writeCycles() == 4);
+    CHECK(memcmp(sim.memory() + 20, buf.data(), buf.size()) == 0);
+    CHECK(sim.memory()[19] == 0xff);
+    CHECK(sim.memory()[120] == 0xff);
+    CHECK(sim.pageWear(0) == 1);
+    CHECK(sim.pageWear(3) == 1);
+    CHECK(sim.pageWear(4) == 0);
+}
+
+TEST_CASE("block write wraps at the end of the memory", "[at24]")
+{
+    EepromSim sim;
+    auto buf = pattern(40, 2);
+    REQUIRE(sim.writeBlock(EepromSim::_memSize - 16, buf.data(), buf.size()));
+    CHECK(sim.writeCycles() == 2);
+    CHECK(memcmp(sim.memory() + EepromSim::_memSize - 16, buf.data(), 16) == 0);
+    CHECK(memcmp(sim.memory(), buf.data() + 16, 24) == 0);
+    CHECK(sim.memory()[24] == 0xff);
+}
+
+TEST_CASE("every page write waits for its write cycle", "[at24]")
+{
+    EepromSim sim;
+    auto buf = pattern(64, 3);
+    REQUIRE(sim.writeBlock(0, buf.data(), buf.size()));
+
+    // the chip was polled through each tWR, the next access is accepted at once
+    CHECK(sim.polls() > 2);
+    CHECK(sim.elapsedUs() >= 2 * EepromSim::_writeCycleUs);
+    uint8_t back[64];
+    auto transactions = sim.transactions();
+    REQUIRE(sim.readBlock(0, back, sizeof(back)));
+    CHECK(sim.transactions() == transactions + 2);
+    CHECK(memcmp(back, buf.data(), sizeof(back)) == 0);
+
+    // back-to-back byte writes
+    sim.writeIO(100, 0x5a);
+    sim.writeIO(101, 0xa5);
+    CHECK(sim.readIO(100) == 0x5a);
+    CHECK(sim.readIO(101) == 0xa5);
+}
+
+TEST_CASE("a write cycle longer than the timeout fails the block", "[at24]")
+{
+    EepromSim sim(EepromSim::_readyTimeoutUs * 2);
+    auto buf = pattern(64, 4);
+    CHECK_FALSE(sim.writeBlock(0, buf.data(), buf.size()));
+    CHECK(sim.writeCycles() == 1);
+
+    // a chip that is gone
+    EepromSim off;
+    off.cutPower(0, 0);
+    CHECK_FALSE(off.writeBlock(0, buf.data(), buf.size()));
+    CHECK_FALSE(off.writeBlock(0, buf.data(), buf.size()));
+}
+
+TEST_CASE("page writes save bus and write cycle time over byte writes", "[at24]")
+{
+    auto buf = pattern(EepromSim::_memSize, 5);
+
+    EepromSim paged;
+    REQUIRE(paged.writeBlock(0, buf.data(), buf.size()));
+
+    EepromSim bytes;
+    for (uint16_t i = 0; i < buf.size(); i++)
+        REQUIRE(bytes.writeBlock(i, &buf[i], 1));
+
+    CHECK(paged.writeCycles() == EepromSim::_pages);
+    CHECK(bytes.writeCycles() == EepromSim::_memSize);
+    CHECK(memcmp(paged.memory(), bytes.memory(), EepromSim::_memSize) == 0);
+    CHECK(paged.elapsedUs() * 20 < bytes.elapsedUs());
+}
+
+TEST_CASE("delta update writes only the changed span of changed pages", "[at24]")
+{
+    auto image = pattern(EepromSim::_memSize, 7);
+    EepromSim sim;
+    REQUIRE(sim.writeBlock(0, image.data(), image.size()));
+    sim.resetStats();
+
+    // page 1 at 2 and 9, page 40 at 0, page 127 at 31
+    image[32 + 2] ^= 0xff;
+    image[32 + 9] ^= 0xff;
+    image[40 * 32] ^= 0xff;
+    image[EepromSim::_memSize - 1] ^= 0xff;
+
+    AT24Block::DeltaStats stats{};
+    REQUIRE(sim.updateBlock(0, image.data(), image.size(), stats));
+    CHECK(memcmp(sim.memory(), image.data(), image.size()) == 0);
+    CHECK(sim.writeCycles() == 3);
+    CHECK(stats._pagesWritten == 3);
+    CHECK(stats._pagesSkipped == EepromSim::_pages - 3);
+    CHECK(stats._bytesWritten == 8 + 1 + 1);
+    CHECK(stats._bytesSkipped == EepromSim::_memSize - 10);
+
+    // nothing changed - nothing written, the statistics add up
+    REQUIRE(sim.updateBlock(0, image.data(), image.size(), stats));
+    CHECK(sim.writeCycles() == 3);
+    CHECK(stats._pagesWritten == 3);
+    CHECK(stats._pagesSkipped == 2 * EepromSim::_pages - 3);
+}
+
+TEST_CASE("delta update of an unaligned range across the end of the memory", "[at24]")
+{
+    EepromSim sim;
+    auto buf = pattern(70, 8);
+    AT24Block::DeltaStats stats{};
+    REQUIRE(sim.updateBlock(EepromSim::_memSize - 20, buf.data(), buf.size(), stats));
+    CHECK(stats._pagesWritten == 3); // 20 + 32 + 18
+    CHECK(memcmp(sim.memory() + EepromSim::_memSize - 20, buf.data(), 20) == 0);
+    CHECK(memcmp(sim.memory(), buf.data() + 20, 50) == 0);
+
+    buf[69] ^= 1;
+    REQUIRE(sim.updateBlock(EepromSim::_memSize - 20, buf.data(), buf.size(), stats));
+    CHECK(stats._pagesWritten == 4);
+    CHECK(stats._bytesWritten == 70 + 1);
+    CHECK(sim.memory()[49] == buf[69]);
+}
+
+TEST_CASE("delta update saves the write cycles of a mostly unchanged image", "[at24]")
+{
+    auto image = pattern(EepromSim::_memSize, 9);
+    EepromSim full, delta;
+    REQUIRE(full.writeBlock(0, image.data(), image.size()));
+    REQUIRE(delta.writeBlock(0, image.data(), image.size()));
+    full.resetStats();
+    delta.resetStats();
+
+    image[100] ^= 1;
+    image[2000] ^= 1;
+    AT24Block::DeltaStats stats{};
+    REQUIRE(full.writeBlock(0, image.data(), image.size()));
+    REQUIRE(delta.updateBlock(0, image.data(), image.size(), stats));
+    CHECK(delta.writeCycles() == 2);
+    CHECK(full.writeCycles() == EepromSim::_pages);
+
+    // every page is still read, about 3 ms against 8 ms of a page write
+    CHECK(delta.elapsedUs() * 2 < full.elapsedUs());
+}
+
+TEST_CASE("block write benchmark", "[.][benchmark]")
+{
+    auto buf = pattern(EepromSim::_memSize, 6);
+    EepromSim sim;
+
+    BENCHMARK("page-split write of 4 KB")
+    {
+        return sim.writeBlock(0, buf.data(), buf.size());
+    };
+
+    BENCHMARK("byte writes of 4 KB")
+    {
+        bool ok = true;
+        for (uint16_t i = 0; i < buf.size(); i++)
+            ok &= sim.writeBlock(i, &buf[i], 1);
+        return ok;
+    };
+}
+
+TEST_CASE("delta update benchmark", "[.][benchmark]")
+{
+    auto image = pattern(EepromSim::_memSize, 10);
+    EepromSim sim;
+    sim.writeBlock(0, image.data(), image.size());
+    image[100] ^= 1;
+    image[2000] ^= 1;
+    image[4000] ^= 1;
+    AT24Block::DeltaStats stats{};
+
+    // the virtual bus time is what the chip saves, the host time is the cost of the model
+    BENCHMARK("writeBlock of 4 KB, 3 bytes changed")
+    {
+        return sim.writeBlock(0, image.data(), image.size());
+    };
+
+    BENCHMARK("updateBlock of 4 KB, 3 bytes changed")
+    {
+        image[100] ^= 1;
+        return sim.updateBlock(0, image.data(), image.size(), stats);
+    };
+}
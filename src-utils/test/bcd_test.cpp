@@ -0,0 +1,112 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   bcd_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <random>
+#include "bcd.h"
+
+// the scalar code the codec replaced
+static uint8_t num2Bcd(uint8_t val)
+{
+    return ((val / 10 * 16) + (val % 10));
+}
+
+static uint8_t bcd2Num(uint8_t val)
+{
+    return ((val / 16 * 10) + (val % 16));
+}
+
+// valid bits of the DS3231 time registers 0x00 - 0x06, the hour is decoded separately
+static const uint8_t _timeMask[7] = {0x7f, 0x7f, 0x00, 0x07, 0x3f, 0x1f, 0xff};
+
+TEST_CASE("BCD encode and decode match the scalar code for 0 - 99", "[bcd]")
+{
+    for (uint8_t n = 0; n < 100; n++)
+    {
+        CHECK(Bcd::encode(n) == num2Bcd(n));
+        CHECK(Bcd::decode(num2Bcd(n)) == n);
+        CHECK(Bcd::decode(num2Bcd(n)) == bcd2Num(num2Bcd(n)));
+    }
+    CHECK(Bcd::encode(100) == 0);
+}
+
+TEST_CASE("BCD block decoder handles every value in every lane", "[bcd]")
+{
+    std::mt19937 rng(18);
+    for (uint8_t lane = 0; lane < 8; lane++)
+    {
+        for (uint8_t n = 0; n < 100; n++)
+        {
+            uint8_t in[8], out[8], expected[8];
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                expected[i] = (i == lane) ? n : rng() % 100;
+                in[i] = num2Bcd(expected[i]);
+            }
+
+            Bcd::decodeBlock(in, out, 8);
+            REQUIRE(memcmp(out, expected, 8) == 0);
+        }
+    }
+}
+
+TEST_CASE("BCD round trip of the DS3231 time block with control bits", "[bcd]")
+{
+    std::mt19937 rng(2000);
+    for (uint16_t year = 2000; year < 2100; year++)
+    {
+        uint8_t num[7] = {(uint8_t)(rng() % 60), (uint8_t)(rng() % 60), 0, (uint8_t)(1 + rng() % 7),
+                          (uint8_t)(1 + rng() % 31), (uint8_t)(1 + rng() % 12), (uint8_t)(year - 2000)};
+        uint8_t regs[7], out[7];
+        Bcd::encodeBlock(num, regs, 7);
+
+        // century bit of the month, unused bits of the day set
+        regs[5] |= 0x80;
+        regs[3] |= 0xf8;
+
+        Bcd::decodeBlock(regs, out, 7, _timeMask);
+        CHECK(memcmp(out, num, 7) == 0);
+    }
+}
+
+TEST_CASE("BCD codec benchmark", "[.][benchmark]")
+{
+    uint8_t nums[7] = {58, 59, 23, 7, 31, 12, 99};
+    uint8_t regs[7];
+    for (uint8_t i = 0; i < 7; i++)
+        regs[i] = num2Bcd(nums[i]);
+
+    BENCHMARK("encode scalar")
+    {
+        uint8_t out[7];
+        for (uint8_t i = 0; i < 7; i++)
+            out[i] = num2Bcd(nums[i]);
+        return out[0] + out[6];
+    };
+
+    BENCHMARK("encode table")
+    {
+        uint8_t out[7];
+        Bcd::encodeBlock(nums, out, 7);
+        return out[0] + out[6];
+    };
+
+    BENCHMARK("decode scalar")
+    {
+        uint8_t out[7];
+        for (uint8_t i = 0; i < 7; i++)
+            out[i] = bcd2Num(regs[i] & _timeMask[i]);
+        return out[0] + out[6];
+    };
+
+    BENCHMARK("decode block")
+    {
+        uint8_t out[7];
+        Bcd::decodeBlock(regs, out, 7, _timeMask);
+        return out[0] + out[6];
+    };
+}
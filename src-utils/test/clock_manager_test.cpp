@@ -0,0 +1,107 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   clock_manager_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <cstdlib>
+#include "clock_manager.h"
+
+using Source = ClockManager::Source;
+
+static constexpr int64_t _epochUs = 1673884800ll * 1000000; // 2023-01-16 16:00:00
+static constexpr uint64_t _bootUs = 1000000;
+
+TEST_CASE("GPS outage switches to the internal clock and back without flapping", "[clocks]")
+{
+    const uint32_t outageFrom = 5000, outageTo = 12900; // longer than maxAge
+    const uint32_t dropoutFrom = 15000, dropoutTo = 15003;
+
+    ClockManager clocks;
+    uint32_t lastFix = 0;
+    auto prev = Source::None;
+    uint32_t changes = 0;
+    int64_t last = 0;
+    for (uint32_t k = 0; k < 20000; k++)
+    {
+        int64_t trueUs = _epochUs + (int64_t)k * 1000000;
+        uint64_t local = _bootUs + (uint64_t)k * 1000000;
+
+        uint64_t now = local + 1000;
+        bool fix = !(k >= outageFrom && k < outageTo) && !(k >= dropoutFrom && k < dropoutTo);
+        if (fix)
+        {
+            clocks.report(Source::Gps, trueUs, local, 2000, now);
+            lastFix = k;
+        }
+
+        // DS3231 whole seconds, the TimeBase drifts away from the last fix
+        clocks.report(Source::Rtc, trueUs - 300000, local + 100, 500000, now);
+        uint64_t drift = (uint64_t)(k - lastFix) * 20;
+        clocks.report(Source::Internal, trueUs + (int64_t)drift, local + 200, 5000 + (uint32_t)drift, now);
+
+        clocks.update(now);
+        if (clocks.source() != prev)
+        {
+            changes++;
+            prev = clocks.source();
+        }
+
+        int64_t t = clocks.now(now);
+        REQUIRE(t >= last);
+        last = t;
+
+        if (k == outageFrom + 1000)
+            CHECK(clocks.source() == Source::Internal);
+        if (k == dropoutFrom + 1)
+            CHECK(clocks.source() == Source::Gps);
+    }
+
+    CHECK(changes == 3);
+    CHECK(clocks.switches() == 3);
+    CHECK(clocks.source() == Source::Gps);
+
+    // the hold after leaving the drifted internal clock is over
+    uint64_t local = _bootUs + 19999ull * 1000000 + 1000;
+    CHECK(std::llabs(clocks.now(local) - (_epochUs + 19999ll * 1000000 + 1000)) <= 10);
+}
+
+TEST_CASE("expiry of the last source is reported as a change", "[clocks]")
+{
+    ClockManager clocks(50, 1000, 10 * 1000000);
+    clocks.report(Source::Gps, _epochUs, _bootUs, 2000, _bootUs);
+    REQUIRE(clocks.source() == Source::Gps);
+
+    CHECK_FALSE(clocks.update(_bootUs + 10 * 1000000));
+    CHECK(clocks.update(_bootUs + 10 * 1000000 + 1));
+    CHECK(clocks.source() == Source::None);
+    CHECK(clocks.errorUs(_bootUs + 10 * 1000000 + 1) == ClockManager::_noError);
+    CHECK_FALSE(clocks.update(_bootUs + 20 * 1000000));
+
+    // the published time runs on
+    CHECK(clocks.now(_bootUs + 20 * 1000000) == _epochUs + 20 * 1000000);
+}
+
+TEST_CASE("a reading stamped after now has no age", "[clocks]")
+{
+    ClockManager clocks;
+    clocks.report(Source::Gps, _epochUs, _bootUs + 500, 2000, _bootUs + 500);
+    CHECK(clocks.errorUs(Source::Gps, _bootUs) == 2000);
+    CHECK(clocks.source() == Source::Gps);
+    CHECK_FALSE(clocks.update(_bootUs));
+}
+
+TEST_CASE("a reading applied late keeps the time handed out", "[clocks]")
+{
+    ClockManager clocks;
+    clocks.report(Source::Gps, _epochUs, _bootUs, 2000, _bootUs);
+    int64_t handed = clocks.now(_bootUs + 1200000);
+
+    // stamped at +1 s, 500 us behind, applied 300 ms later
+    clocks.report(Source::Gps, _epochUs + 1000000 - 500, _bootUs + 1000000, 2000, _bootUs + 1300000);
+    CHECK(clocks.now(_bootUs + 1300000) >= handed);
+    CHECK(clocks.now(_bootUs + 1300000) == _epochUs + 1300000);
+    CHECK(clocks.now(_bootUs + 1400000) == _epochUs + 1400000 - 500);
+}
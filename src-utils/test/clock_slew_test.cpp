@@ -0,0 +1,91 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   clock_slew_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <random>
+#include "clock_slew.h"
+
+static constexpr int64_t _epochUs = 1673884800ll * 1000000; // 2023-01-16 16:00:00
+
+// local timer running fast
+static uint64_t localAt(int64_t trueUs, double ppm)
+{
+    return 1000000 + (uint64_t)(trueUs * (1.0 + ppm * 1e-6));
+}
+
+TEST_CASE("slewed GPS fixes keep the clock monotonic and within bounds", "[slew]")
+{
+    const double driftPpm = 20;
+    const uint32_t glitchAt = 1800;
+    std::mt19937 rng(22);
+    std::uniform_int_distribution<int> jitter(-2000, 2000);
+
+    WallClock clock;
+    ClockSlew slew;
+
+    int64_t last = 0;
+    int64_t maxErr = 0;
+    double maxRatePpm = 0;
+    for (uint32_t k = 0; k < 3600; k++)
+    {
+        // the sentence stamp jitters, a glitch shifts one fix by 50 ms
+        int64_t trueUs = (int64_t)k * 1000000;
+        uint64_t stamp = localAt(trueUs + jitter(rng), driftPpm);
+        int64_t reference = _epochUs + trueUs + ((k == glitchAt) ? 50000 : 0);
+        uint64_t now = stamp + 300; // applied after the parsing
+        bool stepped = slew.apply(clock, reference, stamp, now);
+        CHECK(stepped == (k == 0));
+
+        // ten readings until the next fix
+        for (uint32_t i = 1; i <= 10; i++)
+        {
+            int64_t t = trueUs + i * 100000 - 50000;
+            uint64_t local = localAt(t, driftPpm);
+            int64_t v = clock.now(local);
+            REQUIRE(v >= last);
+
+            if (last)
+            {
+                double rate = (double)(v - last) / (double)(local - localAt(t - 100000, driftPpm)) - 1.0;
+                maxRatePpm = std::max(maxRatePpm, std::abs(rate) * 1e6);
+            }
+            last = v;
+
+            if (k > 0)
+                maxErr = std::max(maxErr, std::abs(v - (_epochUs + t)));
+        }
+    }
+
+    // whole microseconds over 100 ms add up to 20 ppm
+    CHECK(slew.steps() == 1);
+    CHECK(maxRatePpm <= ClockSlew::_defaultMaxPpm + 20);
+    CHECK(maxErr <= 2000);
+}
+
+TEST_CASE("large offsets step, a backward step holds the clock", "[slew]")
+{
+    WallClock clock;
+    ClockSlew slew;
+
+    slew.apply(clock, _epochUs, 1000, 1000);
+    CHECK(clock.now(2000) == _epochUs + 1000);
+
+    // 1 s ahead steps at once
+    CHECK(slew.apply(clock, _epochUs + 2000000, 2000, 2000));
+    CHECK(clock.now(3000) == _epochUs + 2001000);
+
+    // 1 s back holds until the new time catches up
+    CHECK(slew.apply(clock, _epochUs + 1002000, 3000, 3000));
+    CHECK(clock.now(4000) == _epochUs + 2001000);
+    CHECK(clock.now(1003000) == _epochUs + 2002000);
+
+    // a small offset is slewed, not stepped
+    CHECK_FALSE(slew.apply(clock, _epochUs + 2002000 + 1000, 1003000, 1003000));
+    CHECK(clock.remainingUs(1003000) == 1000);
+    CHECK(clock.slewPpm(1003000) >= (int32_t)ClockSlew::_defaultMaxPpm - 1);
+    CHECK(clock.remainingUs(1003000 + 2000000) == 0);
+}
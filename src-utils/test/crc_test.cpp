@@ -0,0 +1,78 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   crc_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <random>
+#include <vector>
+#include "crc.h"
+
+static const uint8_t _check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+static std::vector<uint8_t> randomData(size_t len)
+{
+    std::mt19937 rng(42);
+    std::vector<uint8_t> data(len);
+    for (auto &b : data)
+        b = rng() & 0xff;
+    return data;
+}
+
+TEST_CASE("CRC check values of the catalogue", "[crc]")
+{
+    CHECK(Crc::crc16Bitwise(_check, sizeof(_check)) == 0x29b1);
+    CHECK(Crc::crc16Table(_check, sizeof(_check)) == 0x29b1);
+    CHECK(Crc::crc32Bitwise(_check, sizeof(_check)) == 0xcbf43926);
+    CHECK(Crc::crc32Table(_check, sizeof(_check)) == 0xcbf43926);
+    CHECK(Crc::crc32Slice4(_check, sizeof(_check)) == 0xcbf43926);
+}
+
+TEST_CASE("CRC variants agree, also when updated incrementally", "[crc]")
+{
+    auto data = randomData(4099);
+    for (size_t len : {0, 1, 3, 4, 5, 31, 32, 33, 4099})
+    {
+        auto crc16 = Crc::crc16Bitwise(data.data(), len);
+        auto crc32 = Crc::crc32Bitwise(data.data(), len);
+        CHECK(Crc::crc16Table(data.data(), len) == crc16);
+        CHECK(Crc::crc32Table(data.data(), len) == crc32);
+        CHECK(Crc::crc32Slice4(data.data(), len) == crc32);
+
+        size_t half = len / 2;
+        CHECK(Crc::crc16(data.data() + half, len - half, Crc::crc16(data.data(), half)) == crc16);
+        CHECK(Crc::crc32(data.data() + half, len - half, Crc::crc32(data.data(), half)) == crc32);
+    }
+}
+
+TEST_CASE("CRC throughput over 1 MB", "[.][benchmark]")
+{
+    auto data = randomData(1 << 20);
+
+    BENCHMARK("crc16 bitwise")
+    {
+        return Crc::crc16Bitwise(data.data(), data.size());
+    };
+
+    BENCHMARK("crc16 table")
+    {
+        return Crc::crc16Table(data.data(), data.size());
+    };
+
+    BENCHMARK("crc32 bitwise")
+    {
+        return Crc::crc32Bitwise(data.data(), data.size());
+    };
+
+    BENCHMARK("crc32 table")
+    {
+        return Crc::crc32Table(data.data(), data.size());
+    };
+
+    BENCHMARK("crc32 slice-by-4")
+    {
+        return Crc::crc32Slice4(data.data(), data.size());
+    };
+}
@@ -0,0 +1,125 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   drift_estimator_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <random>
+#include "drift_estimator.h"
+
+/**
+ * @brief gated windows of a local timer running ppm fast against the 32 kHz reference
+ *
+ * The gate opens at a random phase of the reference, so the count is quantized
+ * by one edge as on the hardware.
+ */
+class Windows
+{
+public:
+    Windows(double ppm, uint32_t seed) : _ppm(ppm), _rng(seed) {}
+
+    void next(uint64_t windowUs, uint32_t &counts, uint64_t &elapsedUs)
+    {
+        double refS = windowUs / (1.0 + _ppm * 1e-6) / 1e6;
+        double phase = std::uniform_real_distribution<double>(0, 1)(_rng);
+        counts = (uint32_t)std::floor(refS * DriftEstimator::_refHz + phase);
+        elapsedUs = windowUs;
+    }
+
+private:
+    double _ppm;
+    std::mt19937 _rng;
+};
+
+TEST_CASE("the estimate settles to the drift of the synthetic windows", "[drift]")
+{
+    for (double ppm : {-35.5, 0.0, 12.345, 48.0})
+    {
+        Windows w(ppm, 19);
+        DriftEstimator est;
+        for (uint32_t i = 0; i < 60; i++)
+        {
+            uint32_t counts;
+            uint64_t elapsedUs;
+            w.next(10000000, counts, elapsedUs);
+            REQUIRE(est.addWindow(counts, elapsedUs));
+        }
+
+        INFO("ppm " << ppm);
+        CHECK(est.ready());
+        CHECK(est.rejected() == 0);
+        CHECK(est.driftPpb() == Approx(ppm * 1000).margin(1500));
+    }
+}
+
+TEST_CASE("missed edges, overruns and empty windows are rejected", "[drift]")
+{
+    Windows w(20, 7);
+    DriftEstimator est;
+    uint32_t counts;
+    uint64_t elapsedUs;
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        w.next(10000000, counts, elapsedUs);
+        est.addWindow(counts, elapsedUs);
+    }
+    auto settled = est.driftPpb();
+
+    w.next(10000000, counts, elapsedUs);
+    CHECK_FALSE(est.addWindow(counts - 100, elapsedUs));   // missed edges
+    CHECK_FALSE(est.addWindow(counts + 100, elapsedUs));   // extra edges
+    CHECK_FALSE(est.addWindow(counts - 65536, elapsedUs)); // 16 bit counter overrun
+    CHECK_FALSE(est.addWindow(0, elapsedUs));
+    CHECK(est.rejected() == 4);
+    CHECK(est.driftPpb() == settled);
+
+    CHECK(est.addWindow(counts, elapsedUs));
+}
+
+TEST_CASE("local and reference intervals convert back and forth", "[drift]")
+{
+    Windows w(-27.5, 3);
+    DriftEstimator est;
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        uint32_t counts;
+        uint64_t elapsedUs;
+        w.next(10000000, counts, elapsedUs);
+        est.addWindow(counts, elapsedUs);
+    }
+
+    for (int64_t us : {0ll, 1ll, 1000000ll, 3600ll * 1000000, 86400ll * 1000000})
+    {
+        INFO("us " << us);
+        CHECK(est.toReference(est.toLocal(us)) == Approx(us).margin(2));
+        CHECK(est.toLocal(est.toReference(us)) == Approx(us).margin(2));
+    }
+
+    // the local timer runs slow, a true second is shorter locally
+    CHECK(est.toLocal(1000000) == Approx(1000000 - 27.5).margin(2));
+}
+
+TEST_CASE("single window measurement over long windows", "[drift]")
+{
+    // 10 s at exactly 0 and +30.517578125 ppm (one edge)
+    CHECK(DriftEstimator::measurePpb(327680, 10000000) == 0);
+    CHECK(DriftEstimator::measurePpb(0, 10000000) == 0);
+
+    for (uint32_t hours : {1u, 24u, 36u}) // the count of 36 h is close to 2^32
+    {
+        uint64_t refUs = hours * 3600ull * 1000000;
+        uint32_t counts = hours * 3600u * DriftEstimator::_refHz;
+        uint64_t elapsedUs = refUs + refUs / 20000; // +50 ppm
+        INFO("hours " << hours);
+        CHECK(DriftEstimator::measurePpb(counts, elapsedUs) == Approx(50000).margin(2));
+        CHECK(DriftEstimator::measurePpb(counts, refUs - refUs / 20000) == Approx(-50000).margin(2));
+    }
+
+    // a half or a tiny count of a 100 s window, far beyond the int32 ppb range with no saturation
+    CHECK(DriftEstimator::measurePpb(50u * DriftEstimator::_refHz, 100000000) == 1000000000);
+    CHECK(DriftEstimator::measurePpb(1000, 100000000) == INT32_MAX);
+    CHECK(DriftEstimator::measurePpb(1000u * DriftEstimator::_refHz, 100000000) < -800000000);
+}
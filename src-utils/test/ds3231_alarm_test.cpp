@@ -0,0 +1,140 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   ds3231_alarm_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "ds3231_alarm.h"
+
+using Alarm = DS3231Alarm::Alarm;
+using Mode = DS3231Alarm::Mode;
+
+static uint8_t bcd(uint8_t val)
+{
+    return ((val / 10) << 4) | (val % 10);
+}
+
+/**
+ * @brief time registers 0x00 - 0x06, 24 h mode
+ *
+ */
+static void timeRegs(uint32_t s, uint8_t *time)
+{
+    // starts on Sunday the 1st, months of 31 days
+    uint32_t days = s / 86400;
+    time[0] = bcd(s % 60);
+    time[1] = bcd(s / 60 % 60);
+    time[2] = bcd(s / 3600 % 24);
+    time[3] = days % 7 + 1;
+    time[4] = bcd(days % 31 + 1);
+    time[5] = bcd(1);
+    time[6] = bcd(23);
+}
+
+/**
+ * @brief status register 0x0F after a write, OSF/A2F/A1F are cleared by 0 only
+ *
+ */
+static uint8_t statusWrite(uint8_t chip, uint8_t val)
+{
+    uint8_t flags = DS3231Alarm::_OSF | DS3231Alarm::_A2F | DS3231Alarm::_A1F;
+    return (val & ~flags) | (chip & val & flags);
+}
+
+TEST_CASE("alarm match masks against a week of seconds", "[alarm]")
+{
+    const DS3231Alarm::Setting setting{Mode::EverySecond, 17, 42, 13, 3};
+    struct Case
+    {
+        Mode _mode;
+        Alarm _alarm;
+        uint32_t _matches; // in 8 days
+    };
+    const Case cases[] = {
+        {Mode::EverySecond, Alarm::A1, 8 * 86400},
+        {Mode::EveryMinute, Alarm::A1, 8 * 1440},
+        {Mode::EveryMinute, Alarm::A2, 8 * 1440},
+        {Mode::Second, Alarm::A1, 8 * 1440},
+        {Mode::Minute, Alarm::A1, 8 * 24},
+        {Mode::Minute, Alarm::A2, 8 * 24},
+        {Mode::Hour, Alarm::A1, 8},
+        {Mode::Hour, Alarm::A2, 8},
+        {Mode::Date, Alarm::A1, 1},
+        {Mode::Date, Alarm::A2, 1},
+        {Mode::WeekDay, Alarm::A1, 1},
+        {Mode::WeekDay, Alarm::A2, 1},
+    };
+
+    for (auto &c : cases)
+    {
+        auto s = setting;
+        s._mode = c._mode;
+        uint8_t regs[4]{};
+        REQUIRE(DS3231Alarm::encode(c._alarm, s, regs));
+
+        uint32_t n = 0;
+        uint8_t time[7];
+        for (uint32_t t = 0; t < 8 * 86400; t++)
+        {
+            timeRegs(t, time);
+            if (!DS3231Alarm::matches(time, regs, c._alarm))
+                continue;
+            n++;
+
+            // the compared fields are the set ones
+            uint8_t sec = (c._alarm == Alarm::A2 || c._mode == Mode::EveryMinute) ? 0 : setting._sec;
+            if (c._mode != Mode::EverySecond)
+                CHECK(time[0] == bcd(sec));
+            if (c._mode == Mode::Minute || c._mode == Mode::Hour || c._mode == Mode::Date || c._mode == Mode::WeekDay)
+                CHECK(time[1] == bcd(setting._min));
+            if (c._mode == Mode::Hour || c._mode == Mode::Date || c._mode == Mode::WeekDay)
+                CHECK(time[2] == bcd(setting._hour));
+            if (c._mode == Mode::Date)
+                CHECK(time[4] == bcd(setting._day));
+            if (c._mode == Mode::WeekDay)
+                CHECK(time[3] == setting._day + 1);
+        }
+        INFO("mode " << (int)c._mode << " alarm " << (int)c._alarm);
+        CHECK(n == c._matches);
+    }
+}
+
+TEST_CASE("alarm 2 has no seconds", "[alarm]")
+{
+    uint8_t regs[4];
+    CHECK_FALSE(DS3231Alarm::encode(Alarm::A2, {Mode::EverySecond, 0, 0, 0, 0}, regs));
+    CHECK_FALSE(DS3231Alarm::encode(Alarm::A2, {Mode::Second, 10, 0, 0, 0}, regs));
+    CHECK(DS3231Alarm::size(Alarm::A1) == 4);
+    CHECK(DS3231Alarm::size(Alarm::A2) == 3);
+}
+
+TEST_CASE("clearing a flag keeps the other flag, OSF and EN32kHz", "[alarm]")
+{
+    uint8_t all = DS3231Alarm::_OSF | DS3231Alarm::_EN32kHz | DS3231Alarm::_A2F | DS3231Alarm::_A1F;
+
+    uint8_t chip = statusWrite(all, DS3231Alarm::clear(all, Alarm::A1));
+    CHECK(chip == (all & ~DS3231Alarm::_A1F));
+    chip = statusWrite(chip, DS3231Alarm::clear(chip, Alarm::A2));
+    CHECK(chip == (DS3231Alarm::_OSF | DS3231Alarm::_EN32kHz));
+
+    // flags set after the status was read survive
+    uint8_t stale = DS3231Alarm::_A1F;
+    chip = statusWrite(all, DS3231Alarm::clear(stale, Alarm::A1));
+    CHECK((chip & DS3231Alarm::_OSF));
+    CHECK((chip & DS3231Alarm::_A2F));
+    CHECK_FALSE((chip & DS3231Alarm::_A1F));
+    CHECK_FALSE((chip & DS3231Alarm::_EN32kHz));
+}
+
+TEST_CASE("alarm interrupt enable sets INTCN", "[alarm]")
+{
+    uint8_t ctrl = DS3231Alarm::enable(0, Alarm::A1, true);
+    CHECK(ctrl == (DS3231Alarm::_INTCN | DS3231Alarm::_A1IE));
+    ctrl = DS3231Alarm::enable(ctrl, Alarm::A2, true);
+    CHECK(ctrl == (DS3231Alarm::_INTCN | DS3231Alarm::_A1IE | DS3231Alarm::_A2IE));
+    CHECK(DS3231Alarm::enable(ctrl, Alarm::A1, false) == (DS3231Alarm::_INTCN | DS3231Alarm::_A2IE));
+    CHECK(DS3231Alarm::fired(DS3231Alarm::_A2F, Alarm::A2));
+    CHECK_FALSE(DS3231Alarm::fired(DS3231Alarm::_A2F, Alarm::A1));
+}
@@ -0,0 +1,53 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_cache_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "eeprom_sim.h"
+#include "eeprom_cache.h"
+
+TEST_CASE("cache merges writes into one page write per dirty page", "[cache]")
+{
+    EepromSim sim;
+    EepromCache<EepromSim> cache(sim);
+
+    for (uint8_t i = 0; i < 32; i++)
+        cache.writeIO(0x40 + i, i);
+    CHECK(cache.dirty() == 1);
+    CHECK(sim.writeCycles() == 0);
+
+    REQUIRE(cache.flush());
+    CHECK(sim.writeCycles() == 1);
+    for (uint8_t i = 0; i < 32; i++)
+        CHECK(sim.memory()[0x40 + i] == i);
+}
+
+TEST_CASE("cache wraps at the end of the memory like the chip", "[cache]")
+{
+    EepromSim sim;
+    EepromCache<EepromSim> cache(sim);
+
+    uint8_t data[48];
+    for (uint8_t i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    REQUIRE(cache.write(EepromSim::_memSize - 16, data, sizeof(data)));
+
+    // the wrapped part is the same frame as page 0, not an alias of it
+    uint8_t out[sizeof(data)];
+    REQUIRE(cache.read(0, out, 32));
+    CHECK(memcmp(out, data + 16, 32) == 0);
+    CHECK(cache.dirty() == 2);
+
+    REQUIRE(cache.flush());
+    CHECK(sim.writeCycles() == 2);
+    CHECK(memcmp(sim.memory() + EepromSim::_memSize - 16, data, 16) == 0);
+    CHECK(memcmp(sim.memory(), data + 16, 32) == 0);
+
+    EepromCache<EepromSim> again(sim);
+    REQUIRE(again.read(EepromSim::_memSize - 16, out, sizeof(out)));
+    CHECK(memcmp(out, data, sizeof(data)) == 0);
+}
@@ -0,0 +1,125 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_journal_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "eeprom_sim.h"
+#include "eeprom_journal.h"
+
+using Journal = EepromJournal<EepromSim>;
+
+static void payload(uint32_t n, uint8_t *p)
+{
+    memset(p, 0, Journal::_payloadSize);
+    memcpy(p, &n, sizeof(n));
+}
+
+TEST_CASE("journal mounts empty, then finds the newest record", "[journal]")
+{
+    EepromSim sim;
+    Journal log(sim, 0x800, 0x800);
+    REQUIRE_FALSE(log.mount());
+
+    uint8_t p[Journal::_payloadSize];
+    for (uint32_t n = 1; n <= 300; n++)
+    {
+        payload(n, p);
+        REQUIRE(log.append(p, sizeof(p)));
+    }
+
+    Journal again(sim, 0x800, 0x800);
+    REQUIRE(again.mount());
+    CHECK(again.sequence() == 300);
+    CHECK(again.count() == again.slots());
+
+    uint8_t out[Journal::_payloadSize];
+    for (uint16_t back = 0; back < again.count(); back++)
+    {
+        REQUIRE(again.read(back, out));
+        payload(300 - back, p);
+        CHECK(memcmp(out, p, sizeof(p)) == 0);
+    }
+}
+
+TEST_CASE("journal falls back to the last slot when slot 0 is torn", "[journal]")
+{
+    EepromSim sim;
+    Journal log(sim, 0, 0x100);
+    log.mount();
+
+    uint8_t p[Journal::_payloadSize];
+    for (uint32_t n = 1; n <= log.slots(); n++)
+    {
+        payload(n, p);
+        REQUIRE(log.append(p, sizeof(p)));
+    }
+
+    // the next lap starts at slot 0, the write is cut after 5 bytes
+    sim.waitReady();
+    sim.cutPower(0, 5);
+    payload(0, p);
+    CHECK_FALSE(log.append(p, sizeof(p)));
+    sim.restorePower();
+
+    Journal again(sim, 0, 0x100);
+    REQUIRE(again.mount());
+    CHECK(again.head() == again.slots() - 1);
+    CHECK(again.sequence() == again.slots());
+}
+
+TEST_CASE("1M appends wear the pages evenly, mount stays logarithmic", "[journal]")
+{
+    EepromSim sim;
+    Journal log(sim, 0, EepromSim::_memSize);
+    log.mount();
+
+    uint8_t p[Journal::_payloadSize];
+    const uint32_t appends = 1000000;
+    for (uint32_t n = 1; n <= appends; n++)
+    {
+        payload(n, p);
+        REQUIRE(log.append(p, sizeof(p)));
+    }
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (uint16_t page = 0; page < EepromSim::_pages; page++)
+    {
+        lo = std::min(lo, sim.pageWear(page));
+        hi = std::max(hi, sim.pageWear(page));
+    }
+    CHECK(lo >= appends / EepromSim::_pages - 1);
+    CHECK(hi <= appends / EepromSim::_pages + 2);
+
+    // a sequential read is two transactions
+    sim.waitReady();
+    sim.resetStats();
+    Journal again(sim, 0, EepromSim::_memSize);
+    REQUIRE(again.mount());
+    CHECK(again.sequence() == appends);
+    CHECK(sim.transactions() / 2 <= 9);
+}
+
+TEST_CASE("journal benchmark", "[.][benchmark]")
+{
+    EepromSim sim(0, 0);
+    Journal log(sim, 0, EepromSim::_memSize);
+    log.mount();
+
+    uint8_t p[Journal::_payloadSize] = {};
+    for (uint16_t n = 0; n < 1000; n++)
+        log.append(p, sizeof(p));
+
+    BENCHMARK("append")
+    {
+        return log.append(p, sizeof(p));
+    };
+
+    BENCHMARK("mount")
+    {
+        Journal again(sim, 0, EepromSim::_memSize);
+        return again.mount();
+    };
+}
@@ -0,0 +1,150 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_kv_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <stdio.h>
+#include "eeprom_sim.h"
+#include "eeprom_kv.h"
+
+using KV = EepromKV<EepromSim>;
+
+static void keyName(uint16_t i, char *key)
+{
+    snprintf(key, 16, "param.%u", i);
+}
+
+TEST_CASE("KV stores, updates and removes values", "[kv]")
+{
+    EepromSim sim;
+    KV kv(sim, 0x100);
+    REQUIRE(kv.format());
+
+    const uint8_t a[] = {1, 2, 3};
+    const uint8_t b[] = {4, 5};
+    REQUIRE(kv.set("rtc.aging", a, sizeof(a)));
+    REQUIRE(kv.set("lcd.contrast", b, sizeof(b)));
+
+    uint8_t out[KV::_valueSize];
+    uint8_t len = sizeof(out);
+    REQUIRE(kv.get("rtc.aging", out, len));
+    CHECK(len == sizeof(a));
+    CHECK(memcmp(out, a, len) == 0);
+
+    REQUIRE(kv.set("rtc.aging", b, sizeof(b)));
+    len = sizeof(out);
+    REQUIRE(kv.get("rtc.aging", out, len));
+    CHECK(len == sizeof(b));
+
+    REQUIRE(kv.remove("rtc.aging"));
+    len = sizeof(out);
+    CHECK_FALSE(kv.get("rtc.aging", out, len));
+    len = sizeof(out);
+    CHECK(kv.get("lcd.contrast", out, len));
+
+    // too long a value, too small a buffer
+    uint8_t big[KV::_valueSize + 1] = {};
+    CHECK_FALSE(kv.set("big", big, sizeof(big)));
+    len = 1;
+    CHECK_FALSE(kv.get("lcd.contrast", out, len));
+}
+
+TEST_CASE("KV lookup and update cost with 40 keys in 64 slots", "[kv]")
+{
+    EepromSim sim;
+    KV kv(sim, 0);
+    REQUIRE(kv.format());
+
+    char key[16];
+    for (uint16_t i = 0; i < 40; i++)
+    {
+        keyName(i, key);
+        uint8_t v = (uint8_t)i;
+        REQUIRE(kv.set(key, &v, 1));
+    }
+
+    for (uint16_t i = 0; i < 40; i++)
+    {
+        keyName(i, key);
+        sim.waitReady();
+        sim.resetStats();
+
+        uint8_t out[KV::_valueSize];
+        uint8_t len = sizeof(out);
+        REQUIRE(kv.get(key, out, len));
+        CHECK(out[0] == i);
+
+        // the index and the value slot, two transactions per sequential read
+        CHECK(sim.transactions() <= 4);
+
+        sim.resetStats();
+        uint8_t v = (uint8_t)(i + 100);
+        REQUIRE(kv.set(key, &v, 1));
+        CHECK(sim.writeCycles() == 1);
+    }
+}
+
+TEST_CASE("KV refuses a key when all slots are taken", "[kv]")
+{
+    EepromSim sim;
+    EepromKV<EepromSim, 8> kv(sim, 0);
+    REQUIRE(kv.format());
+
+    char key[16];
+    uint8_t v = 0;
+    for (uint16_t i = 0; i < 8; i++)
+    {
+        keyName(i, key);
+        REQUIRE(kv.set(key, &v, 1));
+    }
+    CHECK_FALSE(kv.set("one.more", &v, 1));
+
+    REQUIRE(kv.remove("param.3"));
+    CHECK(kv.set("one.more", &v, 1));
+}
+
+TEST_CASE("KV mount keeps the keys and formats only a corrupt index", "[kv]")
+{
+    const uint16_t base = 0x100;
+    EepromSim sim;
+    KV kv(sim, base);
+
+    // an erased chip is an empty store, nothing written
+    REQUIRE(kv.mount());
+    CHECK(sim.writeCycles() == 0);
+
+    const uint8_t aging[] = {0xfd};
+    const uint8_t count[] = {7};
+    REQUIRE(kv.set("rtc.aging", aging, sizeof(aging)));
+    REQUIRE(kv.set("boot.count", count, sizeof(count)));
+    REQUIRE(kv.mount());
+
+    // a torn update of one value - its entry is dropped, the other key stays
+    uint32_t h = KV::hash("boot.count");
+    uint8_t *slots = sim.memory() + base + KV::_indexSize;
+    uint16_t pos = 0;
+    while (memcmp(slots + pos * 32, &h, 4) != 0)
+        pos++;
+    slots[pos * 32 + 6] ^= 0xff;
+
+    REQUIRE(kv.mount());
+    uint8_t out[KV::_valueSize];
+    uint8_t len = sizeof(out);
+    CHECK_FALSE(kv.get("boot.count", out, len));
+    len = sizeof(out);
+    REQUIRE(kv.get("rtc.aging", out, len));
+    CHECK(out[0] == aging[0]);
+    REQUIRE(kv.set("boot.count", count, sizeof(count)));
+
+    // garbage in the region - mount refuses, format gives an empty store
+    for (uint16_t i = 0; i < KV::_size; i++)
+        sim.memory()[base + i] = (uint8_t)(i * 37 + 11);
+    CHECK_FALSE(kv.mount());
+    REQUIRE(kv.format());
+    REQUIRE(kv.mount());
+    len = sizeof(out);
+    CHECK_FALSE(kv.get("rtc.aging", out, len));
+}
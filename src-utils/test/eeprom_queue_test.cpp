@@ -0,0 +1,91 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_queue_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "eeprom_sim.h"
+#include "eeprom_queue.h"
+
+static EepromSim *_sim = nullptr;
+
+static uint64_t simClock()
+{
+    return _sim->elapsedUs();
+}
+
+static void onDone(void *ctx, bool ok)
+{
+    auto done = static_cast<uint32_t *>(ctx);
+    if (ok)
+        (*done)++;
+}
+
+TEST_CASE("queued writes in a 1 ms main loop never stall longer than a page write", "[queue]")
+{
+    EepromSim sim;
+    _sim = &sim;
+    EepromWriteQueue<EepromSim> queue(sim, simClock);
+
+    uint8_t model[EepromSim::_memSize];
+    memcpy(model, sim.memory(), sizeof(model));
+
+    const uint32_t requests = 4000;
+    const uint16_t len = 40;
+    uint32_t sent = 0, done = 0;
+    uint64_t maxStallUs = 0;
+
+    for (uint32_t tick = 0; sent < requests || !queue.idle(); tick++)
+    {
+        auto start = sim.elapsedUs();
+        if (tick % 50 == 0 && sent < requests)
+        {
+            uint8_t data[len];
+            uint16_t addr = (sent * len) % EepromSim::_memSize;
+            for (uint16_t i = 0; i < len; i++)
+            {
+                data[i] = (uint8_t)(sent + i);
+                model[(addr + i) & (EepromSim::_memSize - 1)] = data[i];
+            }
+            REQUIRE(queue.write(addr, data, len, onDone, &done));
+            sent++;
+        }
+        queue.poll();
+
+        auto spent = sim.elapsedUs() - start;
+        if (spent > maxStallUs)
+            maxStallUs = spent;
+        if (spent < 1000)
+            sim.advance(1000 - spent);
+    }
+
+    CHECK(done == requests);
+    CHECK(queue.stats()._completed == requests);
+    CHECK(queue.stats()._failed == 0);
+    CHECK(memcmp(sim.memory(), model, sizeof(model)) == 0);
+
+    // readiness poll and one full page write
+    CHECK(maxStallUs <= (1 + 3 + EepromSim::_pageSize) * EepromSim::_byteUs);
+    _sim = nullptr;
+}
+
+TEST_CASE("queue refuses a write that does not fit", "[queue]")
+{
+    EepromSim sim;
+    _sim = &sim;
+    EepromWriteQueue<EepromSim, 4> queue(sim, simClock);
+
+    uint8_t data[160] = {};
+    CHECK_FALSE(queue.write(0, data, sizeof(data)));
+    CHECK(queue.write(0, data, 96));
+    CHECK_FALSE(queue.write(0x100, data, 33));
+    CHECK(queue.write(0x100, data, 32));
+    CHECK(queue.stats()._rejected == 2);
+
+    queue.flush();
+    CHECK(queue.idle());
+    CHECK(queue.stats()._completed == 2);
+    _sim = nullptr;
+}
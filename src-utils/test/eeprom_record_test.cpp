@@ -0,0 +1,106 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   eeprom_record_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "eeprom_sim.h"
+#include "eeprom_record.h"
+
+using Record = EepromRecord<EepromSim, 40>; // two pages per slot
+
+static void fill(uint8_t *data, uint8_t v)
+{
+    memset(data, v, 40);
+}
+
+TEST_CASE("record alternates the slots with growing versions", "[record]")
+{
+    EepromSim sim;
+    Record rec(sim, 0x200);
+
+    uint8_t data[40];
+    CHECK(rec.load(data) == Record::Status::Empty);
+
+    for (uint8_t v = 1; v <= 5; v++)
+    {
+        fill(data, v);
+        REQUIRE(rec.save(data));
+        CHECK(rec.version() == v);
+        CHECK(rec.active() == ((v & 1) ? 0 : 1));
+    }
+
+    Record again(sim, 0x200);
+    REQUIRE(again.load(data) == Record::Status::Ok);
+    CHECK(again.version() == 5);
+    CHECK(data[0] == 5);
+}
+
+TEST_CASE("power cut during save leaves the old or the new record", "[record]")
+{
+    uint8_t oldData[40], newData[40], out[40];
+    fill(oldData, 0xa5);
+    fill(newData, 0x3c);
+
+    for (uint32_t after = 0; after < 2; after++)
+    {
+        for (uint16_t torn = 0; torn <= EepromSim::_pageSize; torn += 4)
+        {
+            EepromSim sim;
+            Record rec(sim, 0);
+            REQUIRE(rec.save(oldData));
+            REQUIRE(rec.save(oldData));
+
+            sim.waitReady();
+            sim.cutPower(after, torn);
+            CHECK_FALSE(rec.save(newData));
+            sim.restorePower();
+
+            Record again(sim, 0);
+            REQUIRE(again.load(out) == Record::Status::Ok);
+            bool isOld = memcmp(out, oldData, sizeof(out)) == 0;
+            bool isNew = memcmp(out, newData, sizeof(out)) == 0;
+            CHECK((isOld || isNew));
+        }
+    }
+}
+
+TEST_CASE("record is not saved after an I/O error on load", "[record]")
+{
+    EepromSim sim;
+    uint8_t data[40];
+    {
+        Record rec(sim, 0);
+        for (uint8_t v = 1; v <= 3; v++)
+        {
+            fill(data, v);
+            REQUIRE(rec.save(data));
+        }
+    }
+
+    // the chip stops responding
+    sim.waitReady();
+    sim.cutPower(0);
+    sim.writeIO(0xf00, 0);
+    REQUIRE_FALSE(sim.powered());
+
+    Record rec(sim, 0);
+    CHECK(rec.load(data) == Record::Status::IoError);
+    CHECK_FALSE(rec.loaded());
+
+    // save() loads first, the I/O error refuses the write
+    fill(data, 9);
+    CHECK_FALSE(rec.save(data));
+    CHECK_FALSE(rec.loaded());
+
+    sim.restorePower();
+    REQUIRE(rec.load(data) == Record::Status::Ok);
+    CHECK(rec.version() == 3);
+    CHECK(data[0] == 3);
+
+    fill(data, 4);
+    REQUIRE(rec.save(data));
+    CHECK(rec.version() == 4);
+}
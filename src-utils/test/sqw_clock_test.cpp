@@ -0,0 +1,75 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   sqw_clock_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include "sqw_clock.h"
+
+static constexpr uint32_t _seconds = 1673884800; // 2023-01-16 16:00:00
+static constexpr uint64_t _bootUs = 1000000;
+static constexpr uint32_t _periodUs = 1000020; // local timer 20 ppm fast
+
+static SqwClock anchored(uint32_t edges)
+{
+    SqwClock sqw;
+    sqw.reset();
+    for (uint32_t k = 0; k < edges; k++)
+        sqw.onEdge(_bootUs + (uint64_t)k * _periodUs);
+    sqw.anchor(_seconds, sqw.edges());
+    return sqw;
+}
+
+TEST_CASE("square wave interpolation follows the measured period", "[sqw]")
+{
+    auto sqw = anchored(100);
+    uint64_t edge = _bootUs + 99ull * _periodUs;
+
+    CHECK(sqw.periodUs() == Approx(_periodUs).margin(1));
+    CHECK(sqw.now(edge) == (uint64_t)_seconds * 1000000);
+    CHECK(sqw.now(edge + _periodUs / 2) == Approx((double)_seconds * 1000000 + 500000).margin(1));
+
+    // a missed edge does not run the second on
+    CHECK(sqw.now(edge + 3 * _periodUs) == (uint64_t)_seconds * 1000000 + 999999);
+}
+
+TEST_CASE("a stamp before the last edge lies in the previous second", "[sqw]")
+{
+    auto sqw = anchored(100);
+    uint64_t edge = _bootUs + 99ull * _periodUs;
+
+    // e.g. a GPS sentence stamped just before the edge
+    CHECK(sqw.now(edge - 1) == (uint64_t)_seconds * 1000000 - 1);
+    CHECK(sqw.now(edge - _periodUs / 2) == Approx((double)_seconds * 1000000 - 500000).margin(1));
+    CHECK(sqw.now(edge - _periodUs) == Approx((double)(_seconds - 1) * 1000000).margin(1));
+}
+
+TEST_CASE("an anchor with a stale edge count is refused", "[sqw]")
+{
+    SqwClock sqw;
+    sqw.reset();
+    CHECK_FALSE(sqw.anchor(_seconds, sqw.edges()));
+
+    sqw.onEdge(_bootUs);
+    auto edges = sqw.edges();
+    sqw.onEdge(_bootUs + _periodUs); // came during the RTC read
+    CHECK_FALSE(sqw.anchor(_seconds, edges));
+    CHECK(sqw.anchor(_seconds + 1, sqw.edges()));
+
+    // later edges count on from the anchor
+    sqw.onEdge(_bootUs + 2 * _periodUs);
+    CHECK(sqw.now(_bootUs + 2 * _periodUs) == (uint64_t)(_seconds + 2) * 1000000);
+}
+
+TEST_CASE("long times without edges do not overflow", "[sqw]")
+{
+    auto sqw = anchored(100);
+    uint64_t edge = _bootUs + 99ull * _periodUs;
+
+    // beyond 2^32 us the Q32 product would overflow
+    CHECK(sqw.now(edge + 5000ull * 1000000) == (uint64_t)_seconds * 1000000 + 999999);
+    CHECK(sqw.now(edge + 100000ull * 1000000) == (uint64_t)_seconds * 1000000 + 999999);
+    CHECK(sqw.now(edge - 5000ull * _periodUs) == Approx((double)(_seconds - 5000) * 1000000).margin(2));
+}
@@ -0,0 +1,9 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   test_main.cpp
+/// @author Petr Vanek
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
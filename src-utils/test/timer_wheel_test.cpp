@@ -0,0 +1,203 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   timer_wheel_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include "timer_wheel.h"
+
+using Wheel = TimerWheel<10000>;
+using Firing = std::pair<Wheel::Handle, uint32_t>;
+
+struct Recorder
+{
+    Wheel *_wheel;
+    std::vector<Firing> _fired;
+};
+
+static void record(void *ctx, Wheel::Handle h)
+{
+    auto r = static_cast<Recorder *>(ctx);
+    r->_fired.push_back({h, r->_wheel->now()});
+}
+
+/**
+ * @brief 10k random timers against the brute force reference
+ *
+ * The clock steps back by backStep every stepEvery seconds, the timers keep
+ * their absolute expiry, so the reference is the same as without the steps.
+ */
+static void simulate(uint32_t backStep, uint32_t stepEvery)
+{
+    const uint32_t start = 1673884800;
+    const uint32_t horizon = 400000;
+    std::mt19937 rng(25);
+    std::uniform_int_distribution<uint32_t> expiry(1, horizon / 2);
+    std::uniform_int_distribution<uint32_t> period(30, 5000);
+    std::uniform_int_distribution<uint32_t> step(1, 50);
+
+    auto wheel = std::make_unique<Wheel>(start);
+    Recorder rec{wheel.get(), {}};
+
+    struct Timer
+    {
+        Wheel::Handle _h;
+        uint32_t _expiry;
+        uint32_t _period;
+    };
+    std::vector<Timer> timers;
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        uint32_t e = start + expiry(rng);
+        uint32_t p = (i % 3 == 0) ? period(rng) : 0;
+        auto h = wheel->add(e, p, &record, &rec);
+        REQUIRE(h != Wheel::_invalid);
+        timers.push_back({h, e, p});
+    }
+    CHECK(wheel->add(start + 1, 0, &record, &rec) == Wheel::_invalid);
+
+    for (uint32_t i = 0; i < timers.size(); i += 7)
+        CHECK(wheel->cancel(timers[i]._h));
+    CHECK_FALSE(wheel->cancel(timers[0]._h));
+
+    uint32_t now = start;
+    uint32_t nextBack = start + stepEvery;
+    while (now - start < horizon)
+    {
+        now += step(rng);
+        if (backStep && (int32_t)(now - nextBack) >= 0 && now - start < horizon)
+        {
+            wheel->advance(now);
+            now -= backStep;
+            nextBack = now + backStep + stepEvery;
+        }
+        wheel->advance(now);
+    }
+
+    std::vector<Firing> expected;
+    for (uint32_t i = 0; i < timers.size(); i++)
+    {
+        if (i % 7 == 0)
+            continue;
+        auto &t = timers[i];
+        for (uint32_t e = t._expiry; e <= now; e += t._period)
+        {
+            expected.push_back({t._h, e});
+            if (!t._period)
+                break;
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(rec._fired.begin(), rec._fired.end());
+    CHECK(rec._fired.size() == expected.size());
+    CHECK(rec._fired == expected);
+    // the periodic ones left
+    uint16_t periodic = 0;
+    for (uint32_t i = 0; i < timers.size(); i++)
+        periodic += (i % 7 != 0 && timers[i]._period != 0);
+    CHECK(wheel->active() == periodic);
+}
+
+TEST_CASE("10k random timers fire as the brute force reference", "[wheel]")
+{
+    simulate(0, 0);
+}
+
+TEST_CASE("backward steps of the clock keep the absolute expiries", "[wheel]")
+{
+    // across the level 0, 1 and 2 blocks
+    simulate(100, 10007);
+    simulate(5000, 30011);
+    simulate(90000, 150001);
+}
+
+TEST_CASE("timers beyond the wheel range are placed again", "[wheel]")
+{
+    auto wheel = std::make_unique<Wheel>(0);
+    Recorder rec{wheel.get(), {}};
+    auto far = wheel->add(Wheel::_range * 3 + 12345, 0, &record, &rec);
+    auto near = wheel->add(Wheel::_range - 1, 0, &record, &rec);
+
+    for (uint32_t now = 0; now < Wheel::_range * 4; now += 100000)
+        wheel->advance(now);
+
+    std::vector<Firing> expected{{far, Wheel::_range * 3 + 12345}, {near, Wheel::_range - 1}};
+    std::sort(expected.begin(), expected.end());
+    std::sort(rec._fired.begin(), rec._fired.end());
+    CHECK(rec._fired == expected);
+}
+
+TEST_CASE("a timer added after a backward step fires in the time lived through again", "[wheel]")
+{
+    auto wheel = std::make_unique<Wheel>(1000);
+    Recorder rec{wheel.get(), {}};
+    auto once = wheel->add(1500, 0, &record, &rec);
+    auto every = wheel->add(1100, 100, &record, &rec);
+
+    wheel->advance(1050);
+    wheel->advance(500);
+    CHECK(wheel->now() == 500);
+    CHECK(rec._fired.empty());
+
+    // a timer in the time lived through again
+    auto again = wheel->add(700, 0, &record, &rec);
+    uint32_t when;
+    REQUIRE(wheel->nextWakeup(when));
+    CHECK(when <= 700);
+
+    wheel->advance(1099);
+    REQUIRE(rec._fired.size() == 1);
+    CHECK(rec._fired[0] == Firing{again, 700});
+
+    wheel->advance(1500);
+    std::vector<Firing> expected{{again, 700}, {every, 1100}, {every, 1200}, {every, 1300},
+                                 {every, 1400}, {every, 1500}, {once, 1500}};
+    std::sort(expected.begin(), expected.end());
+    std::sort(rec._fired.begin(), rec._fired.end());
+    CHECK(rec._fired == expected);
+}
+
+static void noop(void *, Wheel::Handle)
+{
+}
+
+TEST_CASE("timer wheel benchmark", "[.][benchmark]")
+{
+    std::mt19937 rng(25);
+    std::uniform_int_distribution<uint32_t> expiry(1, 100000);
+    std::vector<uint32_t> expiries(10000);
+    for (auto &e : expiries)
+        e = expiry(rng);
+    std::vector<Wheel::Handle> handles(expiries.size());
+    auto wheel = std::make_unique<Wheel>(0);
+
+    BENCHMARK("add and cancel 10k")
+    {
+        for (size_t i = 0; i < expiries.size(); i++)
+            handles[i] = wheel->add(expiries[i], 0, &noop, nullptr);
+        for (auto h : handles)
+            wheel->cancel(h);
+        return wheel->active();
+    };
+
+    BENCHMARK_ADVANCED("expire 10k")(Catch::Benchmark::Chronometer meter)
+    {
+        // a full wheel for every run
+        std::vector<std::unique_ptr<Wheel>> wheels(meter.runs());
+        for (auto &w : wheels)
+        {
+            w = std::make_unique<Wheel>(0);
+            for (auto e : expiries)
+                w->add(e, 0, &noop, nullptr);
+        }
+        meter.measure([&](int i) { wheels[i]->advance(100000); return wheels[i]->active(); });
+    };
+}
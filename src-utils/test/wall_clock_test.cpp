@@ -0,0 +1,83 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   wall_clock_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <random>
+#include "wall_clock.h"
+
+static constexpr int64_t _epochUs = 1673884800ll * 1000000; // 2023-01-16 16:00:00
+static constexpr uint64_t _bootUs = 1000000;
+
+TEST_CASE("an anchor stamped in the past keeps the time handed out since the stamp", "[wall]")
+{
+    WallClock clock;
+    clock.anchor(_epochUs, _bootUs);
+    CHECK(clock.now(_bootUs + 1000) == _epochUs + 1000);
+
+    // a reading stamped at +500, 300 us behind, anchored at +1000
+    clock.anchor(_epochUs + 200, _bootUs + 500, _bootUs + 1000);
+    CHECK(clock.now(_bootUs + 1000) == _epochUs + 1000);
+    CHECK(clock.now(_bootUs + 1200) == _epochUs + 1000);
+    CHECK(clock.now(_bootUs + 1400) == _epochUs + 1100);
+
+    // ahead, effective at once
+    clock.anchor(_epochUs + 3000, _bootUs + 1500, _bootUs + 2000);
+    CHECK(clock.now(_bootUs + 2000) == _epochUs + 3500);
+}
+
+TEST_CASE("random past-stamped anchors never turn the clock back", "[wall]")
+{
+    std::mt19937 rng(21);
+    std::uniform_int_distribution<int> offset(-5000, 5000);
+    std::uniform_int_distribution<int> delay(0, 300000);
+
+    WallClock clock;
+    uint64_t local = _bootUs;
+    int64_t last = 0;
+    for (uint32_t k = 0; k < 100000; k++)
+    {
+        // a fix every second, stamped up to 300 ms before it is applied
+        local += 1000000;
+        uint64_t stamp = local - delay(rng);
+        clock.anchor(_epochUs + (int64_t)(stamp - _bootUs) + offset(rng), stamp, local);
+
+        for (uint64_t t = local; t < local + 1000000; t += 250000)
+        {
+            int64_t now = clock.now(t);
+            REQUIRE(now >= last);
+            last = now;
+        }
+    }
+}
+
+TEST_CASE("a backward step holds at most _maxHoldUs", "[wall]")
+{
+    WallClock clock;
+    clock.anchor(_epochUs, _bootUs);
+
+    // 0.5 s back - held
+    clock.anchor(_epochUs - 500000, _bootUs);
+    CHECK(clock.now(_bootUs) == _epochUs);
+    CHECK(clock.now(_bootUs + 499999) == _epochUs);
+    CHECK(clock.now(_bootUs + 600000) == _epochUs + 100000);
+
+    // an hour back - at once
+    uint64_t local = _bootUs + 1000000;
+    int64_t before = clock.now(local);
+    clock.anchor(before - 3600ll * 1000000, local);
+    CHECK(clock.now(local) == before - 3600ll * 1000000);
+    CHECK(clock.now(local + 10) == before - 3600ll * 1000000 + 10);
+}
+
+TEST_CASE("set turns the clock back without a hold", "[wall]")
+{
+    WallClock clock;
+    clock.anchor(_epochUs, _bootUs);
+    clock.set(_epochUs - 200000, _bootUs + 1000);
+    CHECK(clock.now(_bootUs + 1000) == _epochUs - 200000);
+    CHECK(clock.now(_bootUs + 2000) == _epochUs - 199000);
+}
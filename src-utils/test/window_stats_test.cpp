@@ -0,0 +1,115 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   window_stats_test.cpp
+/// @author Petr Vanek
+
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include "window_stats.h"
+
+/**
+ * @brief compares every step with a brute force window over random data
+ *
+ * The data has runs up and down and repeated values, the queues see all their cases.
+ */
+template <uint16_t N>
+static void compare(uint32_t seed, uint32_t samples)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> value(-200, 200);
+    std::uniform_int_distribution<int> kind(0, 3);
+
+    WindowStats<int16_t, N> stats;
+    std::deque<int16_t> ref;
+    int16_t val = 0;
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        switch (kind(rng))
+        {
+        case 0:
+            val = value(rng);
+            break;
+        case 1:
+            val++;
+            break;
+        case 2:
+            val--;
+            break;
+        default:
+            break; // repeated
+        }
+
+        stats.add(val);
+        ref.push_back(val);
+        if (ref.size() > N)
+            ref.pop_front();
+
+        int32_t sum = 0;
+        for (auto v : ref)
+            sum += v;
+
+        INFO("N " << N << " sample " << i);
+        REQUIRE(stats.size() == ref.size());
+        REQUIRE(stats.min() == *std::min_element(ref.begin(), ref.end()));
+        REQUIRE(stats.max() == *std::max_element(ref.begin(), ref.end()));
+        REQUIRE(stats.sum() == sum);
+        REQUIRE(stats.mean() == (int16_t)(sum / (int32_t)ref.size()));
+    }
+}
+
+TEST_CASE("running min, max and mean match a brute force window", "[window]")
+{
+    // the first partial window and many wraps of the ring
+    compare<1>(17, 1000);
+    compare<2>(17, 1000);
+    compare<5>(17, 5000);
+    compare<16>(17, 5000);
+    compare<60>(17, 20000);
+}
+
+TEST_CASE("monotonic data keeps the queues at their limits", "[window]")
+{
+    WindowStats<int16_t, 8> stats;
+
+    // rising - the min queue holds the whole window, the max queue one sample
+    for (int16_t v = 0; v < 100; v++)
+    {
+        stats.add(v);
+        CHECK(stats.max() == v);
+        CHECK(stats.min() == std::max(0, v - 7));
+    }
+
+    // falling, below the whole window
+    for (int16_t v = -1; v >= -100; v--)
+    {
+        stats.add(v);
+        CHECK(stats.min() == v);
+        CHECK(stats.max() == ((v > -8) ? 99 : v + 7));
+    }
+}
+
+TEST_CASE("an empty or cleared window reads zero", "[window]")
+{
+    WindowStats<int16_t, 4> stats;
+    CHECK(stats.empty());
+    CHECK(stats.min() == 0);
+    CHECK(stats.max() == 0);
+    CHECK(stats.mean() == 0);
+
+    for (int16_t v : {5, -3, 9, 1, 7})
+        stats.add(v);
+    CHECK(stats.size() == 4);
+    CHECK(stats.mean() == 3);
+
+    stats.clear();
+    CHECK(stats.empty());
+    CHECK(stats.size() == 0);
+    stats.add(-2);
+    CHECK(stats.min() == -2);
+    CHECK(stats.max() == -2);
+    CHECK(stats.mean() == -2);
+}
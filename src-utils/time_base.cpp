@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "time_base.h"
+#include "time_utils.h"
 
 TimeBase::TimeBase()
 {
@@ -36,132 +37,229 @@ bool TimeBase::init()
     
     if (rc) rtc_disable_alarm();
 
+    _refAnchor = false;
     return rc;
 }
 
 
 bool TimeBase::updateTime(datetime_t &dt) {
-    return rtc_set_datetime(&dt);
+    return updateTime(dt, time_us_64());
+}
+
+bool TimeBase::updateTime(datetime_t &dt, uint64_t atUs)
+{
+    auto now = time_us_64();
+    auto ref = (int64_t)TimeUtils::makeUnixTime(dt) * 1000000;
+    auto refNow = ref + (int64_t)(now - atUs);
+
+    if (!_slewMode)
+    {
+        auto rc = write(dt);
+        if (rc)
+        {
+            // the RTC divider keeps its old phase, its ticks are not the reference seconds
+            _wall.anchor(refNow, now);
+            _refAnchor = true;
+        }
+        return rc;
+    }
+
+    bool stepped = _slew.apply(_wall, ref, atUs, now);
+
+    // the RTC keeps whole seconds, rewritten only when it is off
+    Snapshot s;
+    int64_t rtcOff = 0;
+    if (snapshot(s))
+        rtcOff = (int64_t)TimeUtils::makeUnixTime(s._dt) - refNow / 1000000;
+    if (stepped || rtcOff > 1 || rtcOff < -1)
+    {
+        datetime_t t;
+        TimeUtils::breakUnixTime((uint32_t)(refNow / 1000000), t);
+        return write(t);
+    }
+    return true;
 }
 
 datetime_t TimeBase::getTimeDate() {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);
+    auto r = read(t);
     if (!r) memset(&t, 0, sizeof(datetime_t));
     return t;
 }
 
+bool TimeBase::snapshot(Snapshot &s)
+{
+    auto prev = _snap;
+    _snap._valid = rtc_get_datetime(&_snap._dt) && TimeUtils::isValid(_snap._dt);
+    _snap._us = time_us_64();
+
+    // the RTC ticked between two close reads - the second started in between,
+    // only while the RTC is the reference and holds a time past the epoch
+    auto unix = _snap._valid ? TimeUtils::makeUnixTime(_snap._dt) : 0;
+    if (!_slewMode && !_refAnchor && unix != 0 && prev._valid && prev._dt.sec != _snap._dt.sec &&
+        _snap._us - prev._us <= _tickWindowUs)
+    {
+        auto tickUs = prev._us + (_snap._us - prev._us) / 2;
+        _wall.anchor((int64_t)unix * 1000000, tickUs, _snap._us);
+    }
+
+    s = _snap;
+    return _snap._valid;
+}
+
+bool TimeBase::sync(uint32_t timeoutUs)
+{
+    auto start = time_us_64();
+    Snapshot s;
+    if (!snapshot(s))
+        return false;
+
+    auto sec = s._dt.sec;
+    while (time_us_64() - start < timeoutUs)
+    {
+        if (!snapshot(s))
+            return false;
+        if (s._dt.sec != sec)
+            return true;
+    }
+    return false;
+}
+
+bool TimeBase::read(datetime_t &t, bool fresh)
+{
+    if (fresh || !_cached || !_snap._valid || time_us_64() - _snap._us >= _maxAgeUs)
+    {
+        Snapshot s;
+        if (!snapshot(s))
+            return false;
+    }
+    t = _snap._dt;
+    return true;
+}
+
+bool TimeBase::write(datetime_t &t)
+{
+    _snap._valid = false;
+    auto rc = rtc_set_datetime(&t);
+    if (rc && _writeHook)
+        _writeHook(_writeCtx);
+    return rc;
+}
+
 
 int16_t TimeBase::year()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.year : -1);
 }
 
 int8_t TimeBase::month()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.month : -1);
 }
 
 int8_t TimeBase::day()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.day : -1);
 }
 
 int8_t TimeBase::hour()
 {
    datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.hour : -1);
 }
 
 int8_t TimeBase::minute()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.min : -1);
 }
 
 int8_t TimeBase::second()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.sec : -1);
 }
 
 int8_t TimeBase::weekDay()
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);	
+    auto r = read(t);
     return (r ? t.dotw : -1);
 }
 
 bool TimeBase::setYear(int16_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.year = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().year(val).commit();
 }
 
 bool TimeBase::setMonth(int8_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.month = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().month(val).commit();
 }
 
 bool TimeBase::setDay(int8_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.day = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().day(val).commit();
 }
 
 bool TimeBase::setWeekDay(int8_t val)
 {
     datetime_t t;
-    auto r = rtc_get_datetime(&t);
+    auto r = read(t, true);
     t.dotw = val;
-    if (r) rtc_set_datetime(&t);
+    if (r) write(t);
     return r;
 }
 
 bool TimeBase::setHour(int8_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.hour = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().hour(val).commit();
 }
 
 bool TimeBase::setMinute(int8_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.min = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().minute(val).commit();
 }
 
 bool TimeBase::setSecond(int8_t val)
 {
-    datetime_t t;
-    auto r = rtc_get_datetime(&t);
-    t.sec = val;
-    if (r) rtc_set_datetime(&t);
-    return r;
+    return edit().second(val).commit();
 }
 
 
+
+bool TimeBase::Edit::commit()
+{
+    datetime_t t;
+    if (!_tb.read(t, true))
+        return false;
+
+    if (_set & _Year) t.year = _dt.year;
+    if (_set & _Month) t.month = _dt.month;
+    if (_set & _Day) t.day = _dt.day;
+    if (_set & _Hour) t.hour = _dt.hour;
+    if (_set & _Minute) t.min = _dt.min;
+    if (_set & _Second) t.sec = _dt.sec;
+
+    if (!TimeUtils::isValid(t))
+        return false;
+
+    TimeUtils::updateDayOfWeek(t);
+
+    // one write of the merged fields in any mode, the time set by hand may go back
+    auto now = time_us_64();
+    if (!_tb.write(t))
+        return false;
+    _tb._wall.set((int64_t)TimeUtils::makeUnixTime(t) * 1000000, now);
+    _tb._refAnchor = false;
+    return true;
+}
@@ -12,6 +12,8 @@
 #include "hardware/rtc.h"
 #include "pico/stdlib.h"
 #include "pico/util/datetime.h"
+#include "wall_clock.h"
+#include "clock_slew.h"
 
 /**
  * @brief - encapsulates the basic real-time control clock in the rp2040
@@ -20,12 +22,189 @@
 class TimeBase
 {
 
+public:
+
+    /**
+     * @brief RTC reading with the moment it was taken
+     *
+     */
+    struct Snapshot
+    {
+        datetime_t _dt;
+        uint64_t _us;     // time_us_64() right after the read
+        bool _valid;
+    };
+
+    /**
+     * @brief multi-field change of the RTC, one read and one write on commit()
+     *
+     * tmb.edit().hour(h).minute(m).commit(); the fields left out keep the current
+     * value, the combined date is validated and the weekday is recomputed.
+     */
+    class Edit
+    {
+    public:
+        Edit &year(int16_t val) { _dt.year = val; _set |= _Year; return *this; }
+        Edit &month(int8_t val) { _dt.month = val; _set |= _Month; return *this; }
+        Edit &day(int8_t val) { _dt.day = val; _set |= _Day; return *this; }
+        Edit &hour(int8_t val) { _dt.hour = val; _set |= _Hour; return *this; }
+        Edit &minute(int8_t val) { _dt.min = val; _set |= _Minute; return *this; }
+        Edit &second(int8_t val) { _dt.sec = val; _set |= _Second; return *this; }
+
+        /**
+         * @brief writes the edited fields in one RTC write and sets nowUs() to them,
+         *        no slewing and no hold of a backward change
+         *
+         * @return true - success
+         * @return false - invalid date / time or RTC error, nothing written
+         */
+        bool commit();
+
+    private:
+        friend class TimeBase;
+        explicit Edit(TimeBase &tb) : _tb(tb) {}
+
+        static constexpr uint8_t _Year = 0x01;
+        static constexpr uint8_t _Month = 0x02;
+        static constexpr uint8_t _Day = 0x04;
+        static constexpr uint8_t _Hour = 0x08;
+        static constexpr uint8_t _Minute = 0x10;
+        static constexpr uint8_t _Second = 0x20;
+
+        TimeBase &_tb;
+        datetime_t _dt{};
+        uint8_t _set{0};
+    };
+
+    using WriteHook = void (*)(void *ctx);
+
+    static constexpr uint32_t _defaultMaxAgeUs = 100000;
+    static constexpr uint32_t _tickWindowUs = 1000;  // max. gap of two snapshots bracketing an RTC tick
+
 public:
 
     explicit TimeBase();
     bool init();
     bool updateTime(datetime_t &dt);
+
+    /**
+     * @brief starts a multi-field change, see Edit
+     *
+     */
+    Edit edit() { return Edit(*this); }
+
+    /**
+     * @brief sets the time valid at a past moment, e.g. the start of a GPS sentence
+     *
+     * In the slew mode small offsets are slewed on nowUs() only, the RTC is
+     * rewritten on a step or when it is more than a second off.
+     *
+     * @param dt time
+     * @param atUs time_us_64() stamp when dt began
+     * @return true - success
+     */
+    bool updateTime(datetime_t &dt, uint64_t atUs);
+
+    /**
+     * @brief slewed corrections of nowUs() instead of steps
+     *
+     * @param on slew mode, RTC ticks do not re-anchor nowUs() then
+     * @param stepUs smallest offset that steps the clock
+     * @param maxPpm slew rate
+     */
+    void setSlew(bool on,
+                 uint32_t stepUs = ClockSlew::_defaultStepUs,
+                 uint32_t maxPpm = ClockSlew::_defaultMaxPpm)
+    {
+        _slewMode = on;
+        _slew = ClockSlew(stepUs, maxPpm);
+    }
+
+    /**
+     * @brief offset measured by the last updateTime() in the slew mode
+     *
+     * @return int64_t - reference - clock in microseconds
+     */
+    int64_t offsetUs() const { return _slew.offsetUs(); }
+
+    /**
+     * @brief part of the offset still being slewed
+     *
+     */
+    int64_t remainingUs() const { return _wall.remainingUs(time_us_64()); }
+
+    /**
+     * @brief current slew rate
+     *
+     * @return int32_t - ppm, 0 - no slew in progress
+     */
+    int32_t slewPpm() const { return _wall.slewPpm(time_us_64()); }
     datetime_t getTimeDate();
+
+    /**
+     * @brief reads the whole datetime in one RTC access and stamps it
+     *
+     * @param s [out] snapshot, also kept for the cached mode
+     * @return true - success and a valid datetime
+     */
+    bool snapshot(Snapshot &s);
+
+    /**
+     * @brief the getters answer from the last snapshot while it is younger
+     *        than maxAgeUs, a new one is taken otherwise. Setters drop the snapshot.
+     *
+     * @param on cached mode
+     * @param maxAgeUs snapshot life time
+     */
+    void setCached(bool on, uint32_t maxAgeUs = _defaultMaxAgeUs)
+    {
+        _cached = on;
+        _maxAgeUs = maxAgeUs;
+    }
+
+    bool cached() const { return _cached; }
+
+    /**
+     * @brief called after every successful RTC write, e.g. to re-arm alarms set for the old time
+     *
+     * @param hook callback, nullptr - none
+     * @param ctx user context
+     */
+    void setWriteHook(WriteHook hook, void *ctx)
+    {
+        _writeHook = hook;
+        _writeCtx = ctx;
+    }
+
+    /**
+     * @brief last snapshot, without RTC access
+     *
+     */
+    const Snapshot &lastSnapshot() const { return _snap; }
+
+    /**
+     * @brief monotonic wall-clock time, one timer read, no RTC access
+     *
+     * Anchored by updateTime() and by every RTC tick seen between two
+     * snapshots less than _tickWindowUs apart (see sync()). The ticks are
+     * ignored after updateTime() in the step mode until the time is set by hand,
+     * the reference is more exact than the phase of the rewritten RTC.
+     *
+     * @return int64_t - unixtime in microseconds, 0 before the first anchor
+     */
+    int64_t nowUs() const
+    {
+        return _wall.now(time_us_64());
+    }
+
+    /**
+     * @brief polls the RTC until it ticks over and anchors nowUs() to the tick,
+     *        if the tick may anchor it (see nowUs())
+     *
+     * @param timeoutUs max. waiting time, a tick comes every second
+     * @return true - anchored
+     */
+    bool sync(uint32_t timeoutUs = 1100000);
    
     /**
      * @brief reads year
@@ -127,6 +306,28 @@ public:
 
    
 private:
-   
-   
+    /**
+     * @brief datetime for the getters, cached or fresh
+     *
+     * @param t [out]
+     * @param fresh true - always from the RTC (read-modify-write of the setters)
+     */
+    bool read(datetime_t &t, bool fresh = false);
+
+    /**
+     * @brief writes the RTC and drops the snapshot
+     *
+     */
+    bool write(datetime_t &t);
+
+private:
+    Snapshot _snap{};
+    WallClock _wall;
+    ClockSlew _slew;
+    bool _slewMode{false};
+    bool _refAnchor{false};   // the last anchor came from updateTime()
+    bool _cached{false};
+    uint32_t _maxAgeUs{_defaultMaxAgeUs};
+    WriteHook _writeHook{nullptr};
+    void *_writeCtx{nullptr};
 };
@@ -132,6 +132,23 @@ public:
         return (year + year / 4 - year / 100 + year / 400 + _dayOf[month - 1] + day) % 7;
     }
 
+    /**
+     * @brief checks the date and time fields of the structure
+     *
+     * @param tm - datetime_t structure, dotw is not checked
+     * @return true - valid
+     */
+    static bool isValid(const datetime_t &tm)
+    {
+        if (tm.year < 0 || tm.year > 4095 || tm.month < 1 || tm.month > 12 || tm.day < 1)
+            return false;
+        if (tm.hour < 0 || tm.hour > 23 || tm.min < 0 || tm.min > 59 || tm.sec < 0 || tm.sec > 59)
+            return false;
+
+        auto days = _monthDays[tm.month - 1] + ((tm.month == 2 && isLeapYear(tm.year)) ? 1 : 0);
+        return tm.day <= days;
+    }
+
     /**
      * @brief from the structure fields such as year, month and day calculate the day of the week and put it into the structure
      *
@@ -0,0 +1,339 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   timer_wheel.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief hierarchical timer wheel of one-shot and periodic callbacks, 1 s ticks
+ *
+ * 4 levels of 64 slots, level n holds the timers expiring within the next 64 blocks
+ * of 64^n s (level 3 about 194 days, later timers wait there and are placed again).
+ * The slot is taken from the bits of the absolute expiry, so a far timer moves
+ * down a level when its block starts. Insertion and cancel are O(1), the nearest
+ * wake-up is found from the slot occupancy bitmaps. Timers live in a fixed pool
+ * linked into the slots by indexes, no heap.
+ *
+ * Callbacks run from advance(), they may add and cancel timers.
+ * Pure computation, no platform dependencies.
+ *
+ * @tparam Capacity - max. number of active timers
+ */
+template <uint16_t Capacity>
+class TimerWheel
+{
+    static_assert(Capacity > 0 && Capacity < 0xffff, "invalid capacity");
+
+public:
+    static constexpr uint8_t _levels = 4;
+    static constexpr uint8_t _slotBits = 6;
+    static constexpr uint8_t _slots = 1 << _slotBits;
+    static constexpr uint32_t _range = 1ul << (_levels * _slotBits); // 2^24 s
+
+    using Handle = uint32_t; // generation << 16 | index
+    using Callback = void (*)(void *ctx, Handle timer);
+
+    static constexpr Handle _invalid = 0xffffffff;
+
+public:
+    /**
+     * @brief Construct a new wheel
+     *
+     * @param now current time in seconds (e.g. unixtime)
+     */
+    explicit TimerWheel(uint32_t now = 0) : _now(now)
+    {
+        for (uint8_t l = 0; l < _levels; l++)
+        {
+            _occupied[l] = 0;
+            for (uint8_t s = 0; s < _slots; s++)
+                _head[l][s] = _nil;
+        }
+
+        for (uint16_t i = 0; i < Capacity; i++)
+        {
+            _nodes[i]._next = (i + 1 < Capacity) ? i + 1 : _nil;
+            _nodes[i]._gen = 0;
+            _nodes[i]._active = false;
+        }
+        _free = 0;
+    }
+
+    /**
+     * @brief adds a timer
+     *
+     * @param expiry time of the first run, a past time runs at the next advance()
+     * @param period 0 - one-shot, else repeat period in seconds
+     * @param cb callback
+     * @param ctx user context
+     * @return Handle - _invalid when the pool is full
+     */
+    Handle add(uint32_t expiry, uint32_t period, Callback cb, void *ctx)
+    {
+        if (_free == _nil || !cb)
+            return _invalid;
+
+        uint16_t idx = _free;
+        auto &n = _nodes[idx];
+        _free = n._next;
+
+        n._expiry = expiry;
+        n._period = period;
+        n._cb = cb;
+        n._ctx = ctx;
+        n._gen++;
+        n._active = true;
+        _active++;
+        insert(idx);
+        return handle(idx);
+    }
+
+    /**
+     * @brief removes a timer
+     *
+     * @param h handle from add()
+     * @return true - removed
+     * @return false - not active (expired one-shot, already cancelled)
+     */
+    bool cancel(Handle h)
+    {
+        uint16_t idx = h & 0xffff;
+        if (idx >= Capacity || !_nodes[idx]._active || _nodes[idx]._gen != (uint16_t)(h >> 16))
+            return false;
+
+        unlink(idx);
+        release(idx);
+        return true;
+    }
+
+    /**
+     * @brief moves the time on and runs the expired timers
+     *
+     * Periodic timers are rearmed to their next run after now, missed runs are skipped.
+     * A time before the previous one (the clock stepped back) only places the timers
+     * again, they keep their absolute expiry.
+     *
+     * @param now current time in seconds
+     */
+    void advance(uint32_t now)
+    {
+        if ((int32_t)(now - _now) < 0)
+        {
+            rebase(now);
+            return;
+        }
+
+        uint32_t next;
+        while (nextWakeup(next) && (int32_t)(next - now) <= 0)
+        {
+            _now = next;
+
+            // the blocks starting now move down, the highest level first
+            for (uint8_t l = _levels - 1; l > 0; l--)
+            {
+                if (_now & ((1ul << (l * _slotBits)) - 1))
+                    continue;
+                uint8_t s = slotOf(_now, l);
+                while (_head[l][s] != _nil)
+                {
+                    uint16_t idx = _head[l][s];
+                    unlink(idx);
+                    insert(idx);
+                }
+            }
+
+            uint8_t s = slotOf(_now, 0);
+            while (_head[0][s] != _nil)
+            {
+                uint16_t idx = _head[0][s];
+                auto &n = _nodes[idx];
+                auto cb = n._cb;
+                auto ctx = n._ctx;
+                auto h = handle(idx);
+
+                unlink(idx);
+                if (n._period)
+                {
+                    uint32_t late = _now - n._expiry;
+                    n._expiry += (late / n._period + 1) * n._period;
+                    insert(idx);
+                }
+                else
+                {
+                    release(idx);
+                }
+                cb(ctx, h);
+            }
+        }
+        _now = now;
+    }
+
+    /**
+     * @brief the time advance() has work at - a timer expires or a far timer moves down
+     *
+     * @param when [out] seconds
+     * @return true - some timer is active
+     */
+    bool nextWakeup(uint32_t &when) const
+    {
+        bool found = false;
+        uint32_t best = 0;
+        for (uint8_t l = 0; l < _levels; l++)
+        {
+            if (!_occupied[l])
+                continue;
+
+            // distance to the next occupied slot, the current one included
+            uint8_t cur = slotOf(_now, l);
+            uint64_t rot = (_occupied[l] >> cur) | (cur ? (_occupied[l] << (_slots - cur)) : 0);
+            uint32_t d = ctz(rot);
+
+            uint32_t t;
+            if (l == 0)
+                t = _now + d;
+            else
+                t = ((_now >> (l * _slotBits)) + d) << (l * _slotBits);
+
+            if (!found || (int32_t)(t - best) < 0)
+                best = t;
+            found = true;
+        }
+
+        if (found)
+            when = best;
+        return found;
+    }
+
+    /**
+     * @brief expiry of an active timer
+     *
+     */
+    bool expiry(Handle h, uint32_t &when) const
+    {
+        uint16_t idx = h & 0xffff;
+        if (idx >= Capacity || !_nodes[idx]._active || _nodes[idx]._gen != (uint16_t)(h >> 16))
+            return false;
+        when = _nodes[idx]._expiry;
+        return true;
+    }
+
+    uint32_t now() const { return _now; }
+    uint16_t active() const { return _active; }
+
+private:
+    static constexpr uint16_t _nil = 0xffff;
+
+    struct Node
+    {
+        uint32_t _expiry;
+        uint32_t _period;
+        Callback _cb;
+        void *_ctx;
+        uint16_t _next;
+        uint16_t _prev;
+        uint16_t _gen;
+        uint8_t _level;
+        uint8_t _slot;
+        bool _active;
+    };
+
+    static uint8_t slotOf(uint32_t t, uint8_t level)
+    {
+        return (t >> (level * _slotBits)) & (_slots - 1);
+    }
+
+    static uint32_t ctz(uint64_t v)
+    {
+        return (uint32_t)__builtin_ctzll(v);
+    }
+
+    Handle handle(uint16_t idx) const
+    {
+        return ((Handle)_nodes[idx]._gen << 16) | idx;
+    }
+
+    /**
+     * @brief puts the timer into the slot for its expiry
+     *
+     */
+    void insert(uint16_t idx)
+    {
+        auto &n = _nodes[idx];
+        uint32_t exp = ((int32_t)(n._expiry - _now) <= 0) ? _now : n._expiry;
+
+        // the lowest level where the expiry lies less than 64 blocks ahead,
+        // so the slot never aliases the current one
+        uint8_t l = 0;
+        while (l < _levels - 1 && ((exp >> (l * _slotBits)) - (_now >> (l * _slotBits))) >= _slots)
+            l++;
+
+        uint8_t top = (_levels - 1) * _slotBits;
+        if (((exp >> top) - (_now >> top)) >= _slots)
+        {
+            // beyond the wheel, waits in the last block and is placed again
+            exp = ((_now >> top) + _slots - 1) << top;
+        }
+
+        uint8_t s = slotOf(exp, l);
+        n._level = l;
+        n._slot = s;
+        n._prev = _nil;
+        n._next = _head[l][s];
+        if (n._next != _nil)
+            _nodes[n._next]._prev = idx;
+        _head[l][s] = idx;
+        _occupied[l] |= 1ull << s;
+    }
+
+    void unlink(uint16_t idx)
+    {
+        auto &n = _nodes[idx];
+        if (n._prev != _nil)
+            _nodes[n._prev]._next = n._next;
+        else
+            _head[n._level][n._slot] = n._next;
+        if (n._next != _nil)
+            _nodes[n._next]._prev = n._prev;
+
+        if (_head[n._level][n._slot] == _nil)
+            _occupied[n._level] &= ~(1ull << n._slot);
+    }
+
+    /**
+     * @brief moves the wheel back to an earlier time, the slots depend on it
+     *
+     */
+    void rebase(uint32_t now)
+    {
+        for (uint16_t i = 0; i < Capacity; i++)
+            if (_nodes[i]._active)
+                unlink(i);
+
+        _now = now;
+        for (uint16_t i = 0; i < Capacity; i++)
+            if (_nodes[i]._active)
+                insert(i);
+    }
+
+    void release(uint16_t idx)
+    {
+        auto &n = _nodes[idx];
+        n._active = false;
+        n._next = _free;
+        _free = idx;
+        _active--;
+    }
+
+private:
+    uint32_t _now;
+    uint16_t _head[_levels][_slots];
+    uint64_t _occupied[_levels];
+    Node _nodes[Capacity];
+    uint16_t _free;
+    uint16_t _active{0};
+};
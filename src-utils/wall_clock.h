@@ -0,0 +1,226 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   wall_clock.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief epoch microseconds derived from the local timer
+ *
+ * anchor() binds an epoch time to a local timer stamp, now() is the anchor plus
+ * the local time since then. A later anchor that lies behind the time already
+ * returned does not turn the clock back, the clock holds at the old value until
+ * the new time catches up - now() never decreases. The hold is bounded by
+ * _maxHoldUs, a larger backward step (e.g. the time set by hand) turns the clock
+ * back at once, and so does set().
+ *
+ * slew() absorbs an offset gradually instead - the clock runs faster or slower
+ * by a bounded rate until the offset is gone.
+ *
+ * The anchor is guarded by a sequence counter, now() can be called from IRQ.
+ * No platform dependencies.
+ */
+class WallClock
+{
+public:
+    static constexpr int64_t _maxHoldUs = 1000000;
+
+public:
+    /**
+     * @brief binds the epoch time to the local timer
+     *
+     * @param epochUs wall-clock microseconds (e.g. unixtime * 10^6)
+     * @param localUs local timer at that moment, e.g. time_us_64()
+     */
+    void anchor(int64_t epochUs, uint64_t localUs)
+    {
+        anchor(epochUs, localUs, localUs);
+    }
+
+    /**
+     * @brief binds the epoch time taken at a past stamp to the local timer
+     *
+     * @param epochUs wall-clock microseconds at localUs
+     * @param localUs local timer stamp of epochUs, e.g. the start of a GPS sentence
+     * @param nowUs local timer now, not before localUs - the time handed out up to now is kept
+     */
+    void anchor(int64_t epochUs, uint64_t localUs, uint64_t nowUs)
+    {
+        int64_t epoch = epochUs + (int64_t)(nowUs - localUs);
+
+        // time already handed out, held only for a small backward step
+        int64_t floor = INT64_MIN;
+        if (_valid)
+        {
+            floor = read(nowUs);
+            if (floor - epoch > _maxHoldUs)
+                floor = INT64_MIN;
+        }
+
+        store(epoch, nowUs, floor);
+    }
+
+    /**
+     * @brief sets the time, may turn the clock back (e.g. an edit by the user)
+     *
+     * @param epochUs wall-clock microseconds
+     * @param localUs local timer at that moment
+     */
+    void set(int64_t epochUs, uint64_t localUs)
+    {
+        store(epochUs, localUs, INT64_MIN);
+    }
+
+    /**
+     * @brief starts absorbing the offset from the current time, replaces a running slew
+     *
+     * @param offsetUs correction to add, positive - the clock is behind
+     * @param localUs local timer now
+     * @param ratePpm slew rate, below 10^6
+     */
+    void slew(int64_t offsetUs, uint64_t localUs, uint32_t ratePpm)
+    {
+        if (!_valid || ratePpm == 0 || ratePpm >= 1000000)
+            return;
+
+        int64_t now = read(localUs);
+        uint64_t mag = (offsetUs < 0) ? -offsetUs : offsetUs;
+        int64_t rate = ((int64_t)ratePpm << 32) / 1000000;
+
+        _seq++;
+        _epochUs = now;
+        _localUs = localUs;
+        _floorUs = now;
+        _rateQ32 = (offsetUs < 0) ? -rate : rate;
+        _slewUs = offsetUs;
+        _slewEndUs = (mag * 1000000 + ratePpm - 1) / ratePpm;
+        _seq++;
+    }
+
+    /**
+     * @brief part of the slewed offset not applied yet
+     *
+     * @param localUs local timer now
+     * @return int64_t - microseconds
+     */
+    int64_t remainingUs(uint64_t localUs) const
+    {
+        uint32_t seq;
+        int64_t rate, slew;
+        uint64_t local, end;
+        do
+        {
+            seq = _seq;
+            local = _localUs;
+            rate = _rateQ32;
+            slew = _slewUs;
+            end = _slewEndUs;
+        } while ((seq & 1) || seq != _seq);
+
+        return slew - correction(localUs - local, rate, slew, end);
+    }
+
+    /**
+     * @brief current slew rate
+     *
+     * @param localUs local timer now
+     * @return int32_t - ppm, positive - running faster, 0 - no slew in progress
+     */
+    int32_t slewPpm(uint64_t localUs) const
+    {
+        if (remainingUs(localUs) == 0)
+            return 0;
+        return (int32_t)((_rateQ32 * 1000000) >> 32);
+    }
+
+    /**
+     * @brief forgets the anchor
+     *
+     */
+    void reset()
+    {
+        _seq++;
+        _valid = false;
+        _seq++;
+    }
+
+    /**
+     * @brief current wall-clock time
+     *
+     * @param localUs local timer now, e.g. time_us_64()
+     * @return int64_t - epoch microseconds, 0 if not anchored
+     */
+    int64_t now(uint64_t localUs) const
+    {
+        return _valid ? read(localUs) : 0;
+    }
+
+    bool valid() const { return _valid; }
+
+private:
+    void store(int64_t epochUs, uint64_t localUs, int64_t floorUs)
+    {
+        _seq++;
+        _epochUs = epochUs;
+        _localUs = localUs;
+        _floorUs = floorUs;
+        _rateQ32 = 0;
+        _slewUs = 0;
+        _slewEndUs = 0;
+        _valid = true;
+        _seq++;
+    }
+
+    int64_t read(uint64_t localUs) const
+    {
+        uint32_t seq;
+        int64_t epoch, floor, rate, slew;
+        uint64_t local, end;
+        do
+        {
+            seq = _seq;
+            epoch = _epochUs;
+            local = _localUs;
+            floor = _floorUs;
+            rate = _rateQ32;
+            slew = _slewUs;
+            end = _slewEndUs;
+        } while ((seq & 1) || seq != _seq);
+
+        uint64_t elapsed = localUs - local;
+        int64_t t = epoch + (int64_t)elapsed + correction(elapsed, rate, slew, end);
+        return (t < floor) ? floor : t;
+    }
+
+    /**
+     * @brief slew applied after elapsed microseconds, the whole offset at the end
+     *
+     */
+    static int64_t correction(uint64_t elapsed, int64_t rateQ32, int64_t slewUs, uint64_t endUs)
+    {
+        if (slewUs == 0 || (int64_t)elapsed < 0)
+            return 0;
+        if (elapsed >= endUs)
+            return slewUs;
+
+        int64_t c = ((int64_t)elapsed * rateQ32) >> 32;
+        if ((slewUs > 0) ? (c > slewUs) : (c < slewUs))
+            c = slewUs;
+        return c;
+    }
+
+private:
+    volatile uint32_t _seq{0};
+    volatile int64_t _epochUs{0};
+    volatile uint64_t _localUs{0};
+    volatile int64_t _floorUs{0};
+    volatile int64_t _rateQ32{0};     // slew rate, Q32
+    volatile int64_t _slewUs{0};      // offset being slewed
+    volatile uint64_t _slewEndUs{0};  // local time from the anchor to the end of the slew
+    volatile bool _valid{false};
+};
@@ -0,0 +1,108 @@
+//
+// vim: ts=4 et
+// Copyright (c) 2023 Petr Vanek, petr@fotoventus.cz
+//
+/// @file   window_stats.h
+/// @author Petr Vanek
+
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * @brief running min / max / mean over the last N samples, fixed size, no heap
+ *
+ * The sum gives the mean, min and max are kept in monotonic queues, so every
+ * operation is O(1) (add() amortized). Used e.g. for the DS3231 temperature telemetry.
+ *
+ * @tparam T - integer sample type
+ * @tparam N - window length
+ */
+template <class T, uint16_t N>
+class WindowStats
+{
+    static_assert(N > 0, "empty window");
+
+public:
+    /**
+     * @brief adds the sample, the oldest one leaves the window
+     *
+     * @param val sample
+     */
+    void add(T val)
+    {
+        uint16_t pos = _count % N;
+        if (_count >= N)
+        {
+            // the oldest sample leaves before its slot is reused
+            _sum -= _ring[pos];
+            if (_minLen && _minQ[_minHead] + N <= _count)
+            {
+                _minHead = (_minHead + 1) % N;
+                _minLen--;
+            }
+            if (_maxLen && _maxQ[_maxHead] + N <= _count)
+            {
+                _maxHead = (_maxHead + 1) % N;
+                _maxLen--;
+            }
+        }
+        _ring[pos] = val;
+        _sum += val;
+
+        // samples which can never be the minimum / maximum again are dropped
+        while (_minLen && _ring[_minQ[back(_minHead, _minLen)] % N] >= val)
+            _minLen--;
+        _minQ[(_minHead + _minLen++) % N] = _count;
+
+        while (_maxLen && _ring[_maxQ[back(_maxHead, _maxLen)] % N] <= val)
+            _maxLen--;
+        _maxQ[(_maxHead + _maxLen++) % N] = _count;
+
+        _count++;
+    }
+
+    /**
+     * @brief forgets all samples
+     *
+     */
+    void clear()
+    {
+        _count = 0;
+        _sum = 0;
+        _minHead = _minLen = 0;
+        _maxHead = _maxLen = 0;
+    }
+
+    /**
+     * @brief number of samples in the window
+     *
+     */
+    uint16_t size() const
+    {
+        return (_count < N) ? _count : N;
+    }
+
+    bool empty() const { return _count == 0; }
+    T min() const { return empty() ? 0 : _ring[_minQ[_minHead] % N]; }
+    T max() const { return empty() ? 0 : _ring[_maxQ[_maxHead] % N]; }
+    T mean() const { return empty() ? 0 : (T)(_sum / (int32_t)size()); }
+    int32_t sum() const { return _sum; }
+
+private:
+    static uint16_t back(uint16_t head, uint16_t len)
+    {
+        return (head + len - 1) % N;
+    }
+
+private:
+    T _ring[N];
+    uint32_t _minQ[N]; // sample numbers, values increase from the head
+    uint32_t _maxQ[N]; // sample numbers, values decrease from the head
+    uint16_t _minHead{0};
+    uint16_t _minLen{0};
+    uint16_t _maxHead{0};
+    uint16_t _maxLen{0};
+    uint32_t _count{0};
+    int32_t _sum{0};
+};